@@ -28,6 +28,41 @@ The script reads in hard-disk configurations in the output format of the samplin
 only positional argument of this script (i.e., one should use the command 'python3 fitting.py configuration.txt'). This
 script relies on NumPy as an external dependency.
 
+The pressure estimators assume four disks of radius 0.15 in the unit box with walls, i.e., the configurations of the
+sampling programs in this directory, which print plain keyframes. The sampling programs in the naive directory simulate
+any number of disks in a periodic box. Their delta frames, quantized positions, columnar layout, checksums, and sharded
+output are decoded by the functions of Python/naive/common.py, which this script shares. Their configurations, however,
+cannot be analyzed by this script. For these, the decoder is the stream_configurations function in
+Python/naive/common.py.
+
+The optional --start, --stop, and --step command-line arguments select a range of configurations in the file. On the
+first read, the byte offsets of all configurations are stored in the sidecar file configuration.txt.index. Later reads
+use this frame index to seek directly to the selected configurations instead of parsing the file from its beginning.
+The index is rebuilt whenever the size or the modification time of the configuration file changes. Delta frames of the
+sampling programs, which only contain the disks that moved since the previous configuration, are reconstructed from the
+preceding keyframe. Quantized positions and the columnar layout are handled according to the header of the file.
+Configurations whose quantization error is too large for the bin size of the fit are refused. If the file is a manifest
+of a sharded output, its shards are treated as a single sequence of configurations, and each worker process only reads
+the shards of its batches.
+
+With the -p (--processes) command-line argument, the batches are loaded and analyzed by a pool of worker processes. The
+division into batches only depends on the selected configurations, and the pressures of the batches are combined in the
+order of the batches. The output is therefore bit-identical for any number of processes, which allows regression
+tests of the pressures for a fixed configuration file.
+The --cpus command-line argument pins the worker processes to the given CPUs (e.g., '--cpus 0-7,16') so that the
+operating system does not migrate them. By default, only one hardware thread of every physical core is used, and CPUs
+that share a last-level cache are assigned to consecutive workers. The chosen CPUs are printed before the pressures.
+When reading a stream (see below), this script runs in a single process, which is pinned to the first chosen CPU. The
+pinning only applies to the processes of this script. The sampling programs run in a single thread each, and can be
+pinned with the tools of the operating system (e.g., taskset on Linux).
+
+If the filename is '-' or a named pipe, the configurations are read as a stream while the sampling program is running
+(e.g., 'python3 Metropolis_disks_box.py | python3 fitting.py -'). The pressures are then reported after every batch of
+--report_interval configurations, so that a run can be stopped as soon as the error bars are small enough. A final
+configuration that was only partially written (a line without a terminating newline or with a wrong checksum, see the
+--checksums option of the sampling programs) is ignored, so that the output of a killed sampling program can be
+analyzed.
+
 The script considers the distances between all disk pairs and the distances between disks and the walls where the
 distance is small enough, i.e., the shifted distance such that the minimum distance is 0 is smaller than the fit
 interval. Here, The size of the fit interval is 0.1 * sigma. The fit interval is then divided into 100 equal sized bins
@@ -41,10 +76,27 @@ This script prints the pressures and the corresponding error bars calculated fro
 The fitting procedure is defined as a class, initialized with configurations, fit interval, bin size, number of disks,
 box geometry, and radius. The operations on the configurations are defined as methods in the class.
 """
+import argparse
+from array import array
+import bisect
+import importlib.util
+import itertools
+import math
+import multiprocessing
+import multiprocessing.sharedctypes
+import os
+import stat
 import sys
-from typing import List, Sequence
+from typing import Dict, List, Optional, Sequence, Tuple
 import numpy as np
 
+# The output format of the sampling programs is decoded by the functions of the common module in the naive directory,
+# which is loaded under a different name because this directory has its own common module.
+_spec = importlib.util.spec_from_file_location(
+    "naive_common", os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir, "naive", "common.py"))
+naive_common = importlib.util.module_from_spec(_spec)
+_spec.loader.exec_module(naive_common)
+
 
 class Fitting:
     """
@@ -73,11 +125,18 @@ class Fitting:
         Any shifted distance larger than fit_interval is excluded.
     pair_sample_size : int
         Number of all pair distances.
+    position_error : float
+        The maximum error of the position components in the hard-disk configurations (e.g., due to quantization).
     """
-    def __init__(self, fit_interval: float, bin_size: float, n: int, sigma: float, box: Sequence[float]):
+    def __init__(self, fit_interval: float, bin_size: float, n: int, sigma: float, box: Sequence[float],
+                 position_error: float = 0.0):
         """
         Initialize the instance by storing the relevant parameters.
 
+        The position error of the hard-disk configurations changes each pair distance by at most
+        2 * sqrt(2) * position_error. Configurations whose pair distances are not resolved on the scale of a single bin
+        in the fit interval are too coarse for the extrapolation to the contact value and are refused.
+
         Parameters
         ----------
         fit_interval : float
@@ -90,7 +149,17 @@ class Fitting:
             The radius of the hard disk.
         box : Sequence[float]
             The geometry of the simulation box, i.e., the side lengths L_x and L_y.
+        position_error : float, optional
+            The maximum error of the position components in the hard-disk configurations.
+
+        Raises
+        ------
+        RuntimeError
+            If the pair-distance error due to the position error exceeds the bin size.
         """
+        if 2.0 * math.sqrt(2.0) * position_error > bin_size:
+            raise RuntimeError("The position error {0} of the hard-disk configurations is too large for the bin size "
+                               "{1} of the fit.".format(position_error, bin_size))
         self.n = n
         self.sigma = sigma
         self.box = box
@@ -100,51 +169,310 @@ class Fitting:
         self.wall_sample_size = 0
         self.pair_distances_sq = []
         self.pair_sample_size = 0
+        self.position_error = position_error
+
+    @staticmethod
+    def list_shards(filename: str) -> List[str]:
+        """
+        Return the names of the files that store the hard-disk configurations of the given configuration file.
+
+        If the given file is a manifest, i.e., its first line is '# manifest', the following lines contain the names of
+        the shards (relative to the directory of the manifest) in the order of the configurations. Otherwise, the given
+        file stores the configurations itself.
+
+        Parameters
+        ----------
+        filename : str
+            The name of the configuration file or of the manifest.
+
+        Returns
+        -------
+        List[str]
+            The names of the files that store the hard-disk configurations.
+        """
+        with open(filename, "r") as file:
+            if file.readline().split() != ["#", "manifest"]:
+                return [filename]
+            directory = os.path.dirname(filename)
+            return [os.path.join(directory, line.strip()) for line in file if line.strip()]
+
+    @staticmethod
+    def count_configurations(filename: str) -> int:
+        """
+        Return the number of hard-disk configurations in the given configuration file or manifest.
+
+        Parameters
+        ----------
+        filename : str
+            The name of the configuration file or of the manifest.
+
+        Returns
+        -------
+        int
+            The number of hard-disk configurations.
+        """
+        return sum(len(Fitting.index_configurations(shard)[0]) for shard in Fitting.list_shards(filename))
+
+    @staticmethod
+    def load_header(filename: str) -> Dict[str, List[str]]:
+        """
+        Load the header of the given configuration file.
+
+        The header consists of the lines at the beginning of the file that start with '#'. Each header line has the
+        format '# key value ...'. If the positions are quantized to b bits, for example, the header line
+        '# quantization b L_x L_y max_error' is present. For a manifest, the header of its first shard is returned.
+
+        Parameters
+        ----------
+        filename : str
+            The name of the file that stores the hard-disk configurations.
+
+        Returns
+        -------
+        Dict[str, List[str]]
+            The values of each key in the header.
+        """
+        header = {}
+        shards = Fitting.list_shards(filename)
+        if not shards:
+            return header
+        with open(shards[0], "rb") as file:
+            for line in file:
+                if not line.startswith(b"#"):
+                    break
+                naive_common.parse_header_line(line, header)
+        return header
 
     @staticmethod
-    def load_configurations(filename: str) -> List[List[float]]:
+    def index_configurations(filename: str) -> Tuple[List[int], List[int]]:
+        """
+        Return the byte offsets of all hard-disk configurations in the given file, and the index of the keyframe that
+        each configuration depends on.
+
+        A keyframe contains the positions of all hard disks and depends only on itself. A delta frame (a line starting
+        with the letter 'd') depends on the last keyframe before it (see the parse_configuration function in
+        Python/naive/common.py).
+        Header lines starting with '#' are not indexed. A torn final configuration, i.e., a final line without a
+        terminating newline or with a wrong checksum (see the check_line function in Python/naive/common.py), is not
+        indexed either.
+        Such a line is left behind if the sampling program is killed while it writes a configuration.
+
+        The frame index is cached in the sidecar file filename + '.index' together with the size and the modification
+        time of the configuration file, and the number of configurations. If the sidecar file does not exist or is
+        outdated, the configuration file is scanned once and the sidecar file is (re)written. If the sidecar file cannot
+        be written, the frame index is only returned.
+
+        Parameters
+        ----------
+        filename : str
+            The name of the file that stores the hard-disk configurations.
+
+        Returns
+        -------
+        (List[int], List[int])
+            (The byte offsets of the hard-disk configurations, the indices of the keyframes they depend on.)
+
+        Raises
+        ------
+        RuntimeError
+            If the file starts with a delta frame.
+        """
+        status = os.stat(filename)
+        index_filename = filename + ".index"
+        index = array("q")
+        try:
+            with open(index_filename, "rb") as index_file:
+                index.frombytes(index_file.read())
+            if (len(index) >= 3 and index[0] == status.st_size and index[1] == status.st_mtime_ns
+                    and len(index) == 3 + 2 * index[2]):
+                return index[3:3 + index[2]].tolist(), index[3 + index[2]:].tolist()
+        except OSError:
+            pass
+        offsets = []
+        keyframes = []
+        offset = 0
+        last_line = b""
+        checksums = False
+        with open(filename, "rb") as file:
+            for line in file:
+                if not line.endswith(b"\n"):
+                    break
+                if line.startswith(b"# checksums"):
+                    checksums = True
+                if line.strip() and not line.startswith(b"#"):
+                    last_line = line
+                    if not line.startswith(b"d"):
+                        keyframes.append(len(offsets))
+                    elif not keyframes:
+                        raise RuntimeError("The configuration file {0} starts with a delta frame.".format(filename))
+                    else:
+                        keyframes.append(keyframes[-1])
+                    offsets.append(offset)
+                offset += len(line)
+        if offsets and not naive_common.check_line(last_line, checksums):
+            offsets.pop()
+            keyframes.pop()
+        index = array("q", [status.st_size, status.st_mtime_ns, len(offsets)])
+        index.extend(offsets)
+        index.extend(keyframes)
+        try:
+            with open(index_filename, "wb") as index_file:
+                index.tofile(index_file)
+        except OSError:
+            pass
+        return offsets, keyframes
+
+    @staticmethod
+    def load_configurations(filename: str, start: int = 0, stop: Optional[int] = None, step: int = 1,
+                            layout: str = "interleaved") -> List[List[float]]:
         """
         Load the hard-disk configurations from the given file.
 
-        Each line of the file contains a single hard-disk configuration. The (2 * k)th and (2 * k + 1)th floats in the
-        line should be the x- and y-positions of the kth disk, respectively.
+        Each line of the file contains a single hard-disk configuration. In a keyframe, the (2 * k)th and (2 * k + 1)th
+        floats in the line should be the x- and y-positions of the kth disk, respectively. Delta frames are
+        reconstructed from the preceding keyframe, and quantized positions are restored according to the header of the
+        file (see the static self.load_header method, and the parse_configuration function in Python/naive/common.py).
+        The returned configurations always contain the positions of all hard disks as floats.
+
+        Independent of the layout in the file (given by the header line '# layout columnar'), the configurations are
+        returned in the requested layout. In the interleaved layout, the (2 * k)th and (2 * k + 1)th floats are the x-
+        and y-positions of the kth disk. In the columnar layout, the first n floats are the x-positions of all disks,
+        and the last n floats are their y-positions.
+
+        Only the configurations selected by the slice [start:stop:step] are loaded. The frame index of the file (see
+        the static self.index_configurations method) is used to seek to these configurations, or to the keyframes they
+        depend on. If the file is a manifest, the configurations are loaded from its shards (see the static
+        self.list_shards method).
 
         Parameters
         ----------
         filename : str
             The name of the file that stores the hard-disk configurations.
+        start : int, optional
+            The index of the first loaded configuration.
+        stop : int or None, optional
+            The index of the configuration where the loading stops (exclusive). None loads until the end of the file.
+        step : int, optional
+            The step between two loaded configurations.
+        layout : str, optional
+            The layout of the returned configurations, 'interleaved' or 'columnar'.
 
         Returns
         -------
         List[List[float]]
             The hard-disk configurations.
         """
+        shards = Fitting.list_shards(filename)
+        if shards != [filename]:
+            return Fitting.load_sharded_configurations(shards, start, stop, step, layout)
+        offsets, keyframes = Fitting.index_configurations(filename)
+        header = Fitting.load_header(filename)
+        scale = naive_common.position_scale(header)
+        columnar = header.get("layout") == ["columnar"]
         configurations = []
-        with open(filename, "r") as file:
-            for line in file:
-                configurations.append(list(map(float, line.split())))
+        configuration = []
+        current = -1
+        with open(filename, "rb") as file:
+            for k in range(len(offsets))[start:stop:step]:
+                if not keyframes[k] <= current <= k:
+                    current = keyframes[k] - 1
+                file.seek(offsets[current + 1])
+                while current < k:
+                    configuration = naive_common.parse_configuration(file.readline(), configuration, scale,
+                                                                     columnar)
+                    current += 1
+                if layout == "columnar":
+                    configurations.append(configuration[0::2] + configuration[1::2])
+                else:
+                    configurations.append(configuration)
         return configurations
 
-    def compute_wall_distances(self, configurations: List[List[float]]) -> None:
+    @staticmethod
+    def load_sharded_configurations(shards: Sequence[str], start: int = 0, stop: Optional[int] = None, step: int = 1,
+                                    layout: str = "interleaved") -> List[List[float]]:
+        """
+        Load the hard-disk configurations from the given shards, which together form a single sequence of
+        configurations.
+
+        The slice [start:stop:step] refers to the indices in this sequence. Each shard is loaded with the static
+        self.load_configurations method, so that only the shards that contain selected configurations are read.
+
+        Parameters
+        ----------
+        shards : Sequence[str]
+            The names of the shards in the order of the configurations.
+        start : int, optional
+            The index of the first loaded configuration.
+        stop : int or None, optional
+            The index of the configuration where the loading stops (exclusive). None loads until the end.
+        step : int, optional
+            The step between two loaded configurations.
+        layout : str, optional
+            The layout of the returned configurations, 'interleaved' or 'columnar'.
+
+        Returns
+        -------
+        List[List[float]]
+            The hard-disk configurations.
+        """
+        first_frames = list(itertools.accumulate((len(Fitting.index_configurations(shard)[0]) for shard in shards),
+                                                 initial=0))
+        configurations = []
+        for shard, frames in itertools.groupby(range(first_frames[-1])[start:stop:step],
+                                               key=lambda k: bisect.bisect_right(first_frames, k) - 1):
+            frames = [k - first_frames[shard] for k in frames]
+            shard_stop = frames[-1] + (1 if step > 0 else -1)
+            configurations.extend(Fitting.load_configurations(shards[shard], frames[0],
+                                                              shard_stop if shard_stop >= 0 else None, step, layout))
+        return configurations
+
+    def split_components(self, configurations: List[List[float]],
+                         layout: str = "interleaved") -> Tuple[np.ndarray, np.ndarray]:
+        """
+        Return the x- and y-positions of all hard disks in the given configurations as two arrays with one row per
+        configuration and one column per disk.
+
+        For the columnar layout, both arrays are contiguous slices of the configurations. For the interleaved layout,
+        they are strided views.
+
+        Parameters
+        ----------
+        configurations : List[List[float]]
+            The hard-disk configurations.
+        layout : str, optional
+            The layout of the configurations, 'interleaved' or 'columnar' (see the static self.load_configurations
+            method).
+
+        Returns
+        -------
+        (numpy.ndarray, numpy.ndarray)
+            (The x-positions, the y-positions.)
+        """
+        positions = np.array(configurations, dtype=float).reshape(len(configurations), 2 * self.n)
+        if layout == "columnar":
+            return positions[:, :self.n], positions[:, self.n:]
+        return positions[:, 0::2], positions[:, 1::2]
+
+    def compute_wall_distances(self, configurations: List[List[float]], layout: str = "interleaved") -> None:
         """
         Compute and store the wall distances shifted by sigma from the given hard-disk configurations. Only shifted
         distances smaller than self.fit_interval are included.
 
         The required format of the hard-disk configurations is documented in the static self.load_configurations method.
+        The wall distances are computed for all configurations and disks at once in each direction.
 
         Parameters
         ----------
         configurations : List[List[float]]
             The hard-disk configurations.
+        layout : str, optional
+            The layout of the configurations, 'interleaved' or 'columnar'.
         """
-        for configuration in configurations:
-            for i in range(self.n):
-                for d in range(2):
-                    position = configuration[2 * i + d]
-                    if position < self.fit_interval + self.sigma:
-                        self.wall_distances[d].append(position - self.sigma)
-                    elif position > self.box[d] - self.sigma - self.fit_interval:
-                        self.wall_distances[d].append(self.box[d] - position - self.sigma)
+        for d, positions in enumerate(self.split_components(configurations, layout)):
+            low = positions < self.fit_interval + self.sigma
+            high = ~low & (positions > self.box[d] - self.sigma - self.fit_interval)
+            self.wall_distances[d].extend((positions[low] - self.sigma).tolist())
+            self.wall_distances[d].extend((self.box[d] - positions[high] - self.sigma).tolist())
         self.wall_sample_size = len(configurations) * self.n
 
     @staticmethod
@@ -166,26 +494,26 @@ class Fitting:
         """
         return (disk_one[0] - disk_two[0]) ** 2 + (disk_one[1] - disk_two[1]) ** 2
 
-    def compute_distances_sq(self, configurations: List[List[float]]) -> None:
+    def compute_distances_sq(self, configurations: List[List[float]], layout: str = "interleaved") -> None:
         """
          Compute and store the squared pair distances shifted by (2 * sigma) ** 2 from the given hard-disk
          configurations. Only shifted distances smaller than self.fit_interval are included.
 
         The required format of the hard-disk configurations is documented in the static self.load_configurations method.
+        For each disk i, the distances to all disks j < i are computed for all configurations at once.
 
         Parameters
         ----------
         configurations : List[List[float]]
             The hard-disk configurations.
+        layout : str, optional
+            The layout of the configurations, 'interleaved' or 'columnar'.
         """
         criterion = (2. * self.sigma + self.fit_interval) ** 2
-        for configuration in configurations:
-            for i in range(self.n):
-                for j in range(i):
-                    square_distance = self.distance_sq([configuration[2 * i], configuration[2 * i + 1]],
-                                                       [configuration[2 * j], configuration[2 * j + 1]])
-                    if square_distance < criterion:
-                        self.pair_distances_sq.append(square_distance)
+        x, y = self.split_components(configurations, layout)
+        for i in range(1, self.n):
+            square_distances = (x[:, i:i + 1] - x[:, :i]) ** 2 + (y[:, i:i + 1] - y[:, :i]) ** 2
+            self.pair_distances_sq.extend(square_distances[square_distances < criterion].tolist())
         self.pair_sample_size = len(configurations) * self.n * (self.n - 1) / 2
 
     def fit_rho(self, direction: int) -> float:
@@ -237,38 +565,304 @@ class Fitting:
         return p(0)
 
 
+def batch_pressures(configurations: List[List[float]], fit_interval: float, bin_size: float, n: int, sigma: float,
+                    box: Sequence[float], position_error: float = 0.0, layout: str = "interleaved"
+                    ) -> Tuple[float, float]:
+    """
+    Compute the pressures from Eqs (12) and (27a) in [Li2022] for a single batch of hard-disk configurations.
+
+    Parameters
+    ----------
+    configurations : List[List[float]]
+        The hard-disk configurations of the batch.
+    fit_interval : float
+        The maximum considered (shifted) distance in the wall and pair distances.
+    bin_size : float
+        The bin size for the histogram.
+    n : int
+        The number of hard disks.
+    sigma : float
+        The radius of the hard disk.
+    box : Sequence[float]
+        The geometry of the simulation box, i.e., the side lengths L_x and L_y.
+    position_error : float, optional
+        The maximum error of the position components in the hard-disk configurations.
+    layout : str, optional
+        The layout of the configurations, 'interleaved' or 'columnar'.
+
+    Returns
+    -------
+    (float, float)
+        (The wall pressure from Eq. (12), the homothetic pressure from Eq. (27a).)
+    """
+    fit = Fitting(fit_interval, bin_size, n, sigma, box, position_error)
+    fit.compute_wall_distances(configurations, layout)
+    fit.compute_distances_sq(configurations, layout)
+    rho_x = fit.fit_rho(0)
+    rho_y = fit.fit_rho(1)
+    g = fit.fit_g()
+    return (n * (rho_x + rho_y) / 2.0,
+            n + n * (2 * np.pi * (n - 1) * sigma ** 2 * g + sigma * (rho_x + rho_y)))
+
+
+def load_batch_pressures(task: Tuple[str, range, float, float, int, float, Sequence[float], float]
+                         ) -> Tuple[float, float]:
+    """
+    Load a batch of hard-disk configurations from a file and compute its pressures with the batch_pressures function.
+
+    This function is executed by the worker processes of the main function. Each worker reads its batch through the
+    frame index of the file, so that reading and analyzing the batches overlap. The batch is loaded in the columnar
+    layout so that the x- and y-positions of all disks are contiguous.
+
+    Parameters
+    ----------
+    task : (str, range, float, float, int, float, Sequence[float], float)
+        (The name of the file, the indices of the configurations of the batch, followed by the arguments fit_interval,
+        bin_size, n, sigma, box, and position_error of the batch_pressures function.)
+
+    Returns
+    -------
+    (float, float)
+        (The wall pressure from Eq. (12), the homothetic pressure from Eq. (27a).)
+    """
+    filename, frames, *parameters = task
+    stop = frames.stop if frames.stop >= 0 else None
+    return batch_pressures(Fitting.load_configurations(filename, frames.start, stop, frames.step, "columnar"),
+                           *parameters, "columnar")
+
+
+def print_pressures(pressures: Sequence[Tuple[float, float]]) -> None:
+    """
+    Print the mean and the standard error of the wall and homothetic pressures of the given batches.
+
+    Parameters
+    ----------
+    pressures : Sequence[(float, float)]
+        The wall and homothetic pressures of the batches.
+    """
+    pressure_wall = np.array([p[0] for p in pressures])
+    pressure_homothetic = np.array([p[1] for p in pressures])
+    print(r'Wall pressure: {:+.6f} \pm {:+.6f}'.format(
+        pressure_wall.mean(), pressure_wall.std(ddof=1) / np.sqrt(len(pressure_wall))))
+    print(r'Homothetic pressure: {:+.6f} \pm {:+.6f}'.format(
+        pressure_homothetic.mean(), pressure_homothetic.std(ddof=1) / np.sqrt(len(pressure_homothetic))))
+
+
+def stream_pressures(filename: str, batch_size: int, fit_interval: float, bin_size: float, n: int, sigma: float,
+                     box: Sequence[float]) -> None:
+    """
+    Read hard-disk configurations from stdin (filename '-') or from a named pipe while they are produced, and report
+    the pressures from Eqs (12) and (27a) in [Li2022] after every batch of configurations.
+
+    Each report prints the number of analyzed configurations, and the mean and the standard error of the pressures
+    over all completed batches. The first report is printed after two batches. Configurations after the last completed
+    batch are not analyzed.
+
+    Parameters
+    ----------
+    filename : str
+        The name of the named pipe, or '-' for stdin.
+    batch_size : int
+        The number of configurations per batch.
+    fit_interval : float
+        The maximum considered (shifted) distance in the wall and pair distances.
+    bin_size : float
+        The bin size for the histogram.
+    n : int
+        The number of hard disks.
+    sigma : float
+        The radius of the hard disk.
+    box : Sequence[float]
+        The geometry of the simulation box, i.e., the side lengths L_x and L_y.
+    """
+    pressures = []
+    batch = []
+    with (open(filename, "rb") if filename != "-" else sys.stdin.buffer) as file:
+        header = {}
+        for configuration in naive_common.stream_configurations(file, header):
+            batch.append(configuration)
+            if len(batch) == batch_size:
+                position_error = float(header["quantization"][3]) if "quantization" in header else 0.0
+                pressures.append(batch_pressures(batch, fit_interval, bin_size, n, sigma, box, position_error))
+                batch = []
+                if len(pressures) > 1:
+                    print("Configurations: {}".format(len(pressures) * batch_size))
+                    print_pressures(pressures)
+                    sys.stdout.flush()
+
+
+def parse_cpu_list(text: str) -> List[int]:
+    """
+    Return the CPUs in the given CPU list in the format of the Linux kernel, e.g., '0-3,8,10-11'.
+
+    Parameters
+    ----------
+    text : str
+        The CPU list.
+
+    Returns
+    -------
+    List[int]
+        The sorted CPUs.
+
+    Raises
+    ------
+    RuntimeError
+        If the CPU list cannot be parsed.
+    """
+    cpus = set()
+    try:
+        for part in text.strip().split(","):
+            first, _, last = part.partition("-")
+            cpus.update(range(int(first), int(last or first) + 1))
+    except ValueError:
+        raise RuntimeError("The CPU list {0!r} cannot be parsed.".format(text))
+    return sorted(cpus)
+
+
+def read_cpu_topology(cpu: int, name: str) -> Optional[str]:
+    """
+    Return the content of the given file in the sysfs directory of the given CPU, or None if it does not exist.
+
+    Parameters
+    ----------
+    cpu : int
+        The CPU.
+    name : str
+        The name of the file relative to /sys/devices/system/cpu/cpuN.
+
+    Returns
+    -------
+    str or None
+        The stripped content of the file.
+    """
+    try:
+        with open("/sys/devices/system/cpu/cpu{0}/{1}".format(cpu, name)) as file:
+            return file.read().strip()
+    except OSError:
+        return None
+
+
+def worker_cpus(cpus: Sequence[int], allow_siblings: bool = False) -> List[int]:
+    """
+    Return the CPUs for the worker processes from the given CPUs.
+
+    Unless allowed, only the first hardware thread of every physical core is kept so that no two workers compete for
+    the same core. The CPUs are sorted by their last-level cache so that consecutive workers, which analyze consecutive
+    batches, share a cache. If the topology is not available in sysfs, the given CPUs are returned unchanged.
+
+    Parameters
+    ----------
+    cpus : Sequence[int]
+        The available CPUs.
+    allow_siblings : bool, optional
+        Whether several hardware threads of the same physical core may be used.
+
+    Returns
+    -------
+    List[int]
+        The CPUs for the worker processes.
+    """
+    chosen = []
+    for cpu in cpus:
+        siblings = read_cpu_topology(cpu, "topology/thread_siblings_list")
+        if allow_siblings or siblings is None or not any(c in chosen for c in parse_cpu_list(siblings)):
+            chosen.append(cpu)
+
+    def cache_key(cpu: int) -> Tuple[int, int, int]:
+        package = read_cpu_topology(cpu, "topology/physical_package_id")
+        cache = read_cpu_topology(cpu, "cache/index3/id")
+        return int(package or 0), int(cache or 0), cpu
+
+    return sorted(chosen, key=cache_key)
+
+
+def pin_worker(cpus: Sequence[int], counter: multiprocessing.sharedctypes.Synchronized) -> None:
+    """
+    Pin the calling worker process to the next CPU of the given CPUs.
+
+    This function is the initializer of the worker processes of the main function. The shared counter enumerates the
+    workers in the order of their start.
+
+    Parameters
+    ----------
+    cpus : Sequence[int]
+        The CPUs for the worker processes.
+    counter : multiprocessing.sharedctypes.Synchronized
+        The shared number of already pinned workers (see multiprocessing.Value).
+    """
+    with counter.get_lock():
+        index = counter.value
+        counter.value += 1
+    os.sched_setaffinity(0, {cpus[index % len(cpus)]})
+
+
 def main() -> None:
     """
     Read the hard-disk configurations from the file given by the first positional argument to this script, and compute
     the pressures and the corresponding error bars calculated from Eqs (12) and (27a) in [Li2022]. The error bars are
     estimated from computing a pressure estimate for batches of the hard-disk configurations.
+
+    The batches are loaded and analyzed by a pool of worker processes. The number of batches is fixed, and the
+    pressures of the batches are collected in the order of the batches, so that the result does not depend on the
+    number of processes or on their scheduling.
     """
-    configurations = Fitting.load_configurations(sys.argv[1])
+    parser = argparse.ArgumentParser()
+    parser.add_argument("filename", help="file that stores the hard-disk configurations", type=str)
+    parser.add_argument("--start", help="index of the first used configuration (default=0)", default=0, type=int)
+    parser.add_argument("--stop", help="index of the configuration where the reading stops (default: end of file)",
+                        default=None, type=int)
+    parser.add_argument("--step", help="step between two used configurations (default=1)", default=1, type=int)
+    parser.add_argument("-p", "--processes", help="number of worker processes (default=1)", default=1, type=int)
+    parser.add_argument("-r", "--report_interval",
+                        help="number of configurations per batch when reading from stdin or a named pipe, the "
+                             "pressures are reported after each batch (default=1000)",
+                        default=1000, type=int)
+    parser.add_argument("--cpus", help="pin the worker processes to the CPUs in the given list, e.g., 0-7,16 "
+                                       "(default: no pinning)", default=None, type=str)
+    parser.add_argument("--allow_siblings", help="also pin workers to hardware threads of the same physical core",
+                        action="store_true")
+    args = parser.parse_args()
+
     n = 4
-    number_batch = 100
     box = [1.0, 1.0]
     sigma = 0.15
     fit_interval = 0.1 * sigma
     bin_size = 0.01 * fit_interval
-    batch_size = len(configurations) // number_batch
-    pressure_wall = []
-    pressure_homothetic = []
-    for i in range(number_batch):
-        selected_configurations = configurations[batch_size * i: batch_size * (i + 1)][:]
-        fit = Fitting(fit_interval, bin_size, n, sigma, box)
-        fit.compute_wall_distances(selected_configurations)
-        fit.compute_distances_sq(selected_configurations)
-        rho_x = fit.fit_rho(0)
-        rho_y = fit.fit_rho(1)
-        g = fit.fit_g()
-        pressure_wall.append(n * (rho_x + rho_y) / 2.0)
-        pressure_homothetic.append(n + n * (2 * np.pi * (n - 1) * sigma ** 2 * g + sigma * (rho_x + rho_y)))
-    pressure_wall = np.array(pressure_wall)
-    pressure_homothetic = np.array(pressure_homothetic)
-    print(r'Wall pressure: {:+.6f} \pm {:+.6f}'.format(
-        pressure_wall.mean(), pressure_wall.std(ddof=1) / np.sqrt(len(pressure_wall))))
-    print(r'Homothetic pressure: {:+.6f} \pm {:+.6f}'.format(
-        pressure_homothetic.mean(), pressure_homothetic.std(ddof=1) / np.sqrt(len(pressure_homothetic))))
+    cpus = None
+    if args.cpus is not None:
+        if not hasattr(os, "sched_setaffinity"):
+            raise RuntimeError("Pinning processes to CPUs is not supported on this platform.")
+        available = os.sched_getaffinity(0)
+        cpus = worker_cpus([cpu for cpu in parse_cpu_list(args.cpus) if cpu in available], args.allow_siblings)
+        if not cpus:
+            raise RuntimeError("None of the CPUs {0} are available to this process.".format(args.cpus))
+    if args.filename == "-" or stat.S_ISFIFO(os.stat(args.filename).st_mode):
+        # The stream is analyzed in this process only.
+        if cpus:
+            print("Worker CPUs: {}".format(cpus[0]))
+            os.sched_setaffinity(0, {cpus[0]})
+        stream_pressures(args.filename, args.report_interval, fit_interval, bin_size, n, sigma, box)
+        return
+
+    frames = range(Fitting.count_configurations(args.filename))[args.start:args.stop:args.step]
+    header = Fitting.load_header(args.filename)
+    position_error = float(header["quantization"][3]) if "quantization" in header else 0.0
+    number_batch = 100
+    batch_size = len(frames) // number_batch
+    tasks = [(args.filename, frames[batch_size * i: batch_size * (i + 1)], fit_interval, bin_size, n, sigma, box,
+              position_error) for i in range(number_batch)]
+    if cpus:
+        print("Worker CPUs: {}".format(" ".join(str(cpus[i % len(cpus)]) for i in range(args.processes))))
+    if args.processes > 1:
+        initializer, initargs = (pin_worker, (cpus, multiprocessing.Value("i", 0))) if cpus else (None, ())
+        with multiprocessing.Pool(args.processes, initializer, initargs) as pool:
+            pressures = list(pool.imap(load_batch_pressures, tasks))
+    else:
+        if cpus:
+            os.sched_setaffinity(0, {cpus[0]})
+        pressures = [load_batch_pressures(task) for task in tasks]
+    print_pressures(pressures)
 
 
 if __name__ == '__main__':
@@ -37,13 +37,24 @@ An exemplary run can be started via
 
 This script samples the positions of all hard disks in a given time interval and prints them to stdout. The
 (2 * k)th and (2 * k + 1)th floats in the output are the x- and y-positions of the kth disk, respectively.
+If the --keyframe_interval command-line argument is larger than one, only every so many samples contain all disk
+positions. The samples in between only contain the disks that moved since the previous sample (see the
+ConfigurationWriter class in common.py).
+
+With the --pressure command-line argument, the pressure of every sample is printed instead. Because the speed of the
+active disk is not constant in Newtonian event-chain Monte Carlo, the lifting virial (the separation vector from the
+active to the target disk times the velocity of the active disk at the collision) is divided by the integral of the
+squared speed of the active disk over the chain time. For unit speeds, this reduces to Eq. 20. The last line shows the
+mean pressure and its standard error over all samples. The samples are only written if the --output command-line
+argument is given, and several replicas cannot be combined with the --pressure argument.
 """
 import argparse
 import math
 import random
 from typing import Sequence
-from common import correct_periodic_position, separation_vector, create_packed, create_crystal, sample_vel
-random.seed(1)
+from common import (correct_periodic_position, separation_vector, create_initial_configuration, sample_vel,
+                    add_output_arguments, add_initial_arguments, add_replica_arguments, read_configuration,
+                    validate_configuration, start_replicas, print_pressure, ConfigurationWriter)
 
 parser = argparse.ArgumentParser()
 parser.add_argument("n_x", help="number of disks per row", type=int)
@@ -56,24 +67,35 @@ parser.add_argument("shape", choices=["square", "rectangle", "crystal"],
 parser.add_argument("-t", "--chain_time", help="length for each chain (default=80.0)", default=80.0, type=float)
 parser.add_argument("-c", "--n_chains", help="number of chains between sampling (default=1)", default=1, type=int)
 parser.add_argument("-n", "--n_samples", help="number of samples (default=1000)", default=1000, type=int)
+parser.add_argument("-p", "--pressure",
+                    help="print the pressure of every sample and finally its mean instead of the samples, which are "
+                         "then only written to the output file if --output is given",
+                    action="store_true")
+parser.add_argument("-s", "--seed", help="seed of the random number generator (default=1)", default=1, type=int)
+add_initial_arguments(parser)
+add_replica_arguments(parser)
+add_output_arguments(parser)
 args = parser.parse_args()
+if args.pressure and args.replicas > 1:
+    raise RuntimeError("The pressures of several replicas cannot be printed together.")
+random.seed(args.seed)
 
 n = args.n_x * args.n_y
-sigma = math.sqrt(args.eta / (n * math.pi))
-
-if args.shape == "square":
-    aspect_ratio = 1.0
-    box = (1.0 / math.sqrt(aspect_ratio), math.sqrt(aspect_ratio))
-    pos = create_packed(n, sigma, box)
-elif args.shape == "rectangle":
-    aspect_ratio = math.sqrt(3.0) / 2.0
-    box = (1.0 / math.sqrt(aspect_ratio), math.sqrt(aspect_ratio))
-    pos = create_packed(n, sigma, box)
-else:
-    assert args.shape == "crystal"
-    aspect_ratio = math.sqrt(3.0) / 2.0 * args.n_y / args.n_x
-    box = (1.0 / math.sqrt(aspect_ratio), math.sqrt(aspect_ratio))
-    pos = create_crystal(args.n_x, args.n_y, sigma, box)
+sigma, box, pos = create_initial_configuration(args.n_x, args.n_y, args.eta, args.shape,
+                                               args.cache_dir if args.initial is None else None)
+
+if args.initial is not None:
+    pos = read_configuration(args.initial, n)
+    validate_configuration(pos, sigma, box)
+start_replicas(args)
+
+# Only the pressures are printed to stdout with the --pressure command-line argument.
+writer = ConfigurationWriter.from_arguments(args, box, n) if not args.pressure or args.output is not None else None
+moved = set()
+images = [[0, 0] for _ in range(n)]
+sum_virial = 0.0
+sum_speed_sq_time = 0.0
+pressures = []
 
 # Only the collisions within a box centered at the active disk are considered. This cutoff prevents the active disk from
 # interacting with the disks out of the box.
@@ -127,10 +149,13 @@ for sample in range(args.n_samples * args.n_chains):
         target, event_time = first_event
         for d in range(2):
             pos[active][d] += event_time * vel[active][d]
-        pos[active] = correct_periodic_position(pos[active], box)
+        pos[active] = correct_periodic_position(pos[active], box, images[active])
+        moved.add(active)
         chain_time -= event_time
+        sum_speed_sq_time += event_time * (vel[active][0] ** 2 + vel[active][1] ** 2)
         if active != target:
             sep = separation_vector(pos[target], pos[active], box)
+            sum_virial += sep[0] * vel[active][0] + sep[1] * vel[active][1]
             e_parallel = [c / 2.0 / sigma for c in sep]
             dot = (vel[target][0] - vel[active][0]) * e_parallel[0] + (vel[target][1] - vel[active][1]) * e_parallel[1]
             vel[active][0] += e_parallel[0] * dot
@@ -139,4 +164,15 @@ for sample in range(args.n_samples * args.n_chains):
             vel[target][1] -= e_parallel[1] * dot
             active = target
     if (sample + 1) % args.n_chains == 0:
-        print(*iter(comp for s in pos for comp in s))
+        if args.pressure:
+            pressures.append(n * (1.0 + sum_virial / sum_speed_sq_time))
+            print(pressures[-1])
+            sum_virial = 0.0
+            sum_speed_sq_time = 0.0
+        if args.validate_interval > 0 and (sample + 1) // args.n_chains % args.validate_interval == 0:
+            validate_configuration(pos, sigma, box)
+        if writer is not None:
+            writer.write(pos, moved, images)
+if writer is not None:
+    writer.close()
+print_pressure(pressures)
@@ -28,6 +28,13 @@ The script computes the minimum over all pair collision times for the active dis
 updates the position of the active disk, and transfers its velocity to the other colliding disk. The velocity of the
 active disk is restricted to (1, 0) and (0, 1), resulting in an easy implementation of periodic boundary conditions.
 
+With the --n_directions command-line argument D larger than two, the chains instead cycle through the D directions at
+the angles k * pi / D for k = 0, ..., D - 1, which can improve the mixing of crystallites that are not aligned with the
+axes of the box. The collision is then computed from the distances parallel and perpendicular to the velocity in the
+rotated frame, i.e., with the same one-dimensional kernel as for the axis-aligned directions. Because the motion is
+not parallel to an axis of the periodic box, only the nearest periodic images of the disks are considered, and the
+active disk moves at most a cutoff distance before the collisions are recomputed (as in ECMC_reflective.py).
+
 The number of samples, the number of chains between samplings, and the chain time can also be set by the command-line
 arguments. By default, each chain has a chain time of 0.24, and there are 1000 chains between two samples. In total 1000
 samples are produced by default.
@@ -39,14 +46,27 @@ An exemplary run can be started via
 This script samples the positions of all hard disks in a given time interval and prints them to stdout. The
 (2 * k)th and (2 * k + 1)th floats in the output are the x- and y-positions of the kth disk, respectively. The pressure
 in x and in y direction, computed by Eq. 20, can also be printed to stdout. The output of the pressure is done at line
-149 and 151, which are commented out by default.
+243 and 245, which are commented out by default. For more than two directions, the index k of sum_delta_x and
+sum_chain_time refers to the direction at the angle k * pi / D, so that the pressure in y direction has the index D / 2
+for even D.
+
+If the --keyframe_interval command-line argument is larger than one, only every so many samples contain all disk
+positions. The samples in between only contain the disks that moved since the previous sample (see the
+ConfigurationWriter class in common.py). For short chains, this reduces the size of the output considerably.
+
+If the --trace command-line argument is given, every chain and every event (the target disk and the event time) is
+logged in a compact binary trace file, together with checkpoints of the configuration every
+--trace_checkpoint_interval events (see the EventTraceWriter class in common.py). The script replay_ECMC_straight.py
+then rebuilds the configuration after any event from the nearest checkpoint without searching for collisions, and it
+lists the events with negative event times.
 """
 import argparse
 import math
 import random
 from typing import Sequence
-from common import create_packed, create_crystal
-random.seed(1)
+from common import (correct_periodic_position, separation_vector, create_initial_configuration, add_output_arguments,
+                    add_initial_arguments, add_replica_arguments, read_configuration, validate_configuration,
+                    start_replicas, ConfigurationWriter, EventTraceWriter)
 
 parser = argparse.ArgumentParser()
 parser.add_argument("n_x", help="number of disks per row", type=int)
@@ -59,28 +79,47 @@ parser.add_argument("shape", choices=["square", "rectangle", "crystal"],
 parser.add_argument("-t", "--chain_time", help="length for each chain (default=0.24)", default=0.24, type=float)
 parser.add_argument("-c", "--n_chains", help="number of chains between sampling (default=1000)", default=1000, type=int)
 parser.add_argument("-n", "--n_samples", help="number of samples (default=1000)", default=1000, type=int)
+parser.add_argument("-d", "--n_directions",
+                    help="number of chain directions at the angles k * pi / n_directions (default=2, i.e., the x and y "
+                         "directions)",
+                    default=2, type=int)
+parser.add_argument("-s", "--seed", help="seed of the random number generator (default=1)", default=1, type=int)
+add_initial_arguments(parser)
+add_replica_arguments(parser)
+add_output_arguments(parser)
+parser.add_argument("--trace", help="file for a binary trace of all events (default: no trace)", default=None, type=str)
+parser.add_argument("--trace_checkpoint_interval",
+                    help="minimum number of events between two configurations in the trace (default=100000)",
+                    default=100000, type=int)
 args = parser.parse_args()
+random.seed(args.seed)
+if args.n_directions < 2:
+    raise RuntimeError("The chains need at least two directions.")
+if args.trace is not None and args.n_directions != 2:
+    raise RuntimeError("The event trace only supports chains in the x and y directions.")
 
 n = args.n_x * args.n_y
-sigma = math.sqrt(args.eta / (n * math.pi))
-
-if args.shape == "square":
-    aspect_ratio = 1.0
-    box = (1.0 / math.sqrt(aspect_ratio), math.sqrt(aspect_ratio))
-    pos = create_packed(n, sigma, box)
-elif args.shape == "rectangle":
-    aspect_ratio = math.sqrt(3.0) / 2.0
-    box = (1.0 / math.sqrt(aspect_ratio), math.sqrt(aspect_ratio))
-    pos = create_packed(n, sigma, box)
-else:
-    assert args.shape == "crystal"
-    aspect_ratio = math.sqrt(3.0) / 2.0 * args.n_y / args.n_x
-    box = (1.0 / math.sqrt(aspect_ratio), math.sqrt(aspect_ratio))
-    pos = create_crystal(args.n_x, args.n_y, sigma, box)
-
-sum_delta_x = [0.0, 0.0]
-sum_chain_time = [0.0, 0.0]
-direction = random.randint(0, 1)
+sigma, box, pos = create_initial_configuration(args.n_x, args.n_y, args.eta, args.shape,
+                                               args.cache_dir if args.initial is None else None)
+
+if args.initial is not None:
+    pos = read_configuration(args.initial, n)
+    validate_configuration(pos, sigma, box)
+start_replicas(args)
+
+writer = ConfigurationWriter.from_arguments(args, box, n)
+moved = set()
+images = [[0, 0] for _ in range(n)]
+trace = EventTraceWriter(args.trace, n, box, args.trace_checkpoint_interval) if args.trace is not None else None
+
+sum_delta_x = [0.0] * args.n_directions
+sum_chain_time = [0.0] * args.n_directions
+direction = random.randint(0, args.n_directions - 1)
+velocities = [(math.cos(k * math.pi / args.n_directions), math.sin(k * math.pi / args.n_directions))
+              for k in range(args.n_directions)]
+cutoff = min(box[0], box[1]) / 2.0 - 2.0 * sigma
+if args.n_directions != 2 and cutoff <= 0.0:
+    raise RuntimeError("Chains in rotated directions require a box that is wider than four disk radii.")
 
 
 def find_event(pos_active: Sequence[float], pos_target: Sequence[float], direction: int,
@@ -126,21 +165,76 @@ def find_event(pos_active: Sequence[float], pos_target: Sequence[float], directi
         return time_of_flight, delta_x
 
 
+def find_rotated_event(pos_active: Sequence[float], pos_target: Sequence[float], velocity: Sequence[float],
+                       sigma: float, box: Sequence[float]) -> (float, float):
+    """
+    Compute the time when the active hard disk with the given unit velocity collides with the nearest periodic image
+    of the target disk. Also, return the distance between the two disks along the velocity at the collision.
+
+    This is the function find_event in the frame that is rotated so that the velocity is parallel to its first axis.
+    The distance at the collision is returned as zero of the disks never collide, i.e., if the returned collision time
+    is infinite.
+
+    Parameters
+    ----------
+    pos_active : Sequence[float]
+        The position of the active hard disk.
+    pos_target : Sequence[float]
+        The position of the target hard disk.
+    velocity : Sequence[float]
+        The unit velocity of the active disk.
+    sigma : float
+        The radius of the hard disks.
+    box : Sequence[float]
+        The geometry of the box.
+
+    Returns
+    -------
+    (float, float)
+        (The time of the collision of the disks, the distance of the two disks along the velocity at the collision.)
+    """
+    separation = separation_vector(pos_target, pos_active, box)
+    distance_perp = abs(velocity[0] * separation[1] - velocity[1] * separation[0])
+    if distance_perp >= 2.0 * sigma:
+        return math.inf, 0.0
+    distance_para = velocity[0] * separation[0] + velocity[1] * separation[1]
+    if distance_para <= 0.0:
+        return math.inf, 0.0
+    delta_x = math.sqrt(4.0 * sigma ** 2 - distance_perp ** 2)
+    return distance_para - delta_x, delta_x
+
+
 for sample in range(args.n_samples * args.n_chains):
     active = random.randint(0, n - 1)
     chain_time = args.chain_time
     sum_chain_time[direction] += chain_time
+    if trace is not None:
+        trace.start_chain(pos, active, direction)
     while chain_time > 0.0:
-        events = [(target, *find_event(pos[active], pos[target], direction, sigma, box))
-                  for target in range(n) if target != active]
-        events.append((active, chain_time, 0.0))
+        if args.n_directions == 2:
+            events = [(target, *find_event(pos[active], pos[target], direction, sigma, box))
+                      for target in range(n) if target != active]
+            events.append((active, chain_time, 0.0))
+        else:
+            events = [(target, *find_rotated_event(pos[active], pos[target], velocities[direction], sigma, box))
+                      for target in range(n) if target != active]
+            events.append((active, min(chain_time, cutoff), 0.0))
         first_event = min(events, key=lambda t: t[1])
         target, event_time, delta_x = first_event
+        if trace is not None:
+            trace.event(target, event_time)
         # The event time could be slightly negative due to the rounding error of the trigonometry calculation.
         # If the event time is negative, it is set to 0.0 in order to prevent the active disk moving backwards.
-        pos[active][direction] += max(event_time, 0.0)
-        while pos[active][direction] > box[direction]:
-            pos[active][direction] -= box[direction]
+        if args.n_directions == 2:
+            pos[active][direction] += max(event_time, 0.0)
+            while pos[active][direction] > box[direction]:
+                pos[active][direction] -= box[direction]
+                images[active][direction] += 1
+        else:
+            for d in range(2):
+                pos[active][d] += max(event_time, 0.0) * velocities[direction][d]
+            pos[active] = correct_periodic_position(pos[active], box, images[active])
+        moved.add(active)
         sum_delta_x[direction] += delta_x
         active = target
         chain_time -= event_time
@@ -149,7 +243,12 @@ for sample in range(args.n_samples * args.n_chains):
         # print(n * (1 + sum_delta_x[0] / sum_chain_time[0]))
         # P_y calculated using Eq. 20
         # print(n * (1 + sum_delta_x[1] / sum_chain_time[1]))
-        sum_delta_x = [0, 0]
-        sum_chain_time = [0, 0]
-        print(*iter(comp for s in pos for comp in s))
-    direction = 1 - direction
+        sum_delta_x = [0] * args.n_directions
+        sum_chain_time = [0] * args.n_directions
+        if args.validate_interval > 0 and (sample + 1) // args.n_chains % args.validate_interval == 0:
+            validate_configuration(pos, sigma, box)
+        writer.write(pos, moved, images)
+    direction = (direction + 1) % args.n_directions
+writer.close()
+if trace is not None:
+    trace.close()
@@ -28,6 +28,10 @@ The script proposes the displacement of a uniformly sampled disk. The proposed p
 region around the disk center. Only if the proposed position does not introduce any overlap, the proposed position is
 accepted.
 
+The box is divided into cells whose sides are at least 2 * sigma, and every disk is stored in the cell that contains its
+center. A proposed position can therefore only overlap with disks in the 3 x 3 cells around it, and only these disks are
+compared to the proposed position. The samples are identical to the ones that compare against all other disks.
+
 The number of samples and the moves between two samples can also be set by the command-line arguments. By default, the
 number of moves between two samples are 1000, and 1000 samples are produced.
 
@@ -37,13 +41,17 @@ An exemplary run can be started via
 
 This script samples the positions of all hard disks in a given time interval and prints them to stdout. The
 (2 * k)th and (2 * k + 1)th floats in the output are the x- and y-positions of the kth disk, respectively.
+If the --keyframe_interval command-line argument is larger than one, only every so many samples contain all disk
+positions. The samples in between only contain the disks that moved since the previous sample (see the
+ConfigurationWriter class in common.py).
 """
 import argparse
 import math
 import random
-from typing import Sequence
-from common import correct_periodic_position, create_packed, create_crystal, separation_vector
-random.seed(1)
+from typing import Sequence, Tuple
+from common import (correct_periodic_position, create_initial_configuration, separation_vector, add_output_arguments,
+                    add_initial_arguments, add_replica_arguments, read_configuration, validate_configuration,
+                    start_replicas, ConfigurationWriter)
 
 parser = argparse.ArgumentParser()
 parser.add_argument("n_x", help="number of disks per row", type=int)
@@ -56,38 +64,89 @@ parser.add_argument("shape", choices=["square", "rectangle", "crystal"],
 parser.add_argument("-m", "--sample_move", help="number of moves between two samples (default=1000)", default=1000,
                     type=int)
 parser.add_argument("-n", "--n_samples", help="number of samples (default=1000)", default=1000, type=int)
+parser.add_argument("-s", "--seed", help="seed of the random number generator (default=1)", default=1, type=int)
+add_initial_arguments(parser)
+add_replica_arguments(parser)
+add_output_arguments(parser)
 args = parser.parse_args()
+random.seed(args.seed)
 
 n = args.n_x * args.n_y
-sigma = math.sqrt(args.eta / (n * math.pi))
-
-if args.shape == "square":
-    aspect_ratio = 1.0
-    box = (1.0 / math.sqrt(aspect_ratio), math.sqrt(aspect_ratio))
-    pos = create_packed(n, sigma, box)
-elif args.shape == "rectangle":
-    aspect_ratio = math.sqrt(3.0) / 2.0
-    box = (1.0 / math.sqrt(aspect_ratio), math.sqrt(aspect_ratio))
-    pos = create_packed(n, sigma, box)
-else:
-    assert args.shape == "crystal"
-    aspect_ratio = math.sqrt(3.0) / 2.0 * args.n_y / args.n_x
-    box = (1.0 / math.sqrt(aspect_ratio), math.sqrt(aspect_ratio))
-    pos = create_crystal(args.n_x, args.n_y, sigma, box)
+sigma, box, pos = create_initial_configuration(args.n_x, args.n_y, args.eta, args.shape,
+                                               args.cache_dir if args.initial is None else None)
+
+if args.initial is not None:
+    pos = read_configuration(args.initial, n)
+    validate_configuration(pos, sigma, box)
+start_replicas(args)
+
+writer = ConfigurationWriter.from_arguments(args, box, n)
+moved = set()
+images = [[0, 0] for _ in range(n)]
 
 four_sigma_sq = 4.0 * sigma ** 2
 delta = (math.sqrt(1.0 / n / math.pi) - sigma) / 2.0
+# A disk that overlaps with a position lies in the 3 x 3 cells around the cell of that position.
+cell_count = [max(int(box[d] / (2.0 * sigma)), 1) for d in range(2)]
+cells = [[[] for _ in range(cell_count[1])] for _ in range(cell_count[0])]
+# The distinct cells of the 3 x 3 block around every cell (fewer than nine if there are fewer than three cells in a row).
+neighbor_cells = [[sorted({((i + k) % cell_count[0], (j + l) % cell_count[1])
+                           for k in (-1, 0, 1) for l in (-1, 0, 1)})
+                   for j in range(cell_count[1])] for i in range(cell_count[0])]
+
+
+def cell_of(position: Sequence[float], cell_count: Sequence[int], box: Sequence[float]) -> Tuple[int, int]:
+    """
+    Return the indices of the cell that contains the given position.
+
+    Parameters
+    ----------
+    position : Sequence[float]
+        The position.
+    cell_count : Sequence[int]
+        The number of cells in the x and y direction.
+    box : Sequence[float]
+        The geometry of the box.
+
+    Returns
+    -------
+    (int, int)
+        The indices of the cell in the x and y direction.
+    """
+    return (int(position[0] / box[0] * cell_count[0]) % cell_count[0],
+            int(position[1] / box[1] * cell_count[1]) % cell_count[1])
+
+
+for c in range(n):
+    cell = cell_of(pos[c], cell_count, box)
+    cells[cell[0]][cell[1]].append(c)
+
 for sample in range(args.n_samples * args.sample_move):
     a = random.randint(0, n - 1)
-    b = correct_periodic_position([(pos[a][d] + random.uniform(-delta, delta)) % box[d] for d in range(2)], box)
+    proposal = [pos[a][d] + random.uniform(-delta, delta) for d in range(2)]
+    b = correct_periodic_position([proposal[d] % box[d] for d in range(2)], box)
     reject = False
-    for c in range(n):
-        if c != a:
-            separation_vec = separation_vector(b, pos[c], box)
-            if separation_vec[0] ** 2 + separation_vec[1] ** 2 < four_sigma_sq:
-                reject = True
-                break
+    new_cell = cell_of(b, cell_count, box)
+    for i, j in neighbor_cells[new_cell[0]][new_cell[1]]:
+        for c in cells[i][j]:
+            if c != a:
+                separation_vec = separation_vector(b, pos[c], box)
+                if separation_vec[0] ** 2 + separation_vec[1] ** 2 < four_sigma_sq:
+                    reject = True
+                    break
+        if reject:
+            break
     if not reject:
+        old_cell = cell_of(pos[a], cell_count, box)
+        if old_cell != new_cell:
+            cells[old_cell[0]][old_cell[1]].remove(a)
+            cells[new_cell[0]][new_cell[1]].append(a)
         pos[a][:] = b
+        moved.add(a)
+        for d in range(2):
+            images[a][d] += round((proposal[d] - b[d]) / box[d])
     if (sample + 1) % args.sample_move == 0:
-        print(*iter(comp for s in pos for comp in s))
+        if args.validate_interval > 0 and (sample + 1) // args.sample_move % args.validate_interval == 0:
+            validate_configuration(pos, sigma, box)
+        writer.write(pos, moved, images)
+writer.close()
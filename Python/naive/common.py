@@ -21,28 +21,51 @@
 # arXiv e-prints: 2207.07715 (2022), https://arxiv.org/abs/2207.07715.
 #
 """Module for common functions to simulate hard disks in a periodic box."""
+import argparse
+from array import array
+import gc
+import hashlib
+import itertools
 import math
+import mmap
+from multiprocessing import resource_tracker, shared_memory
+import os
 import random
-from typing import List, Sequence
+import struct
+import sys
+import time
+import zlib
+from typing import BinaryIO, Dict, Iterator, List, Optional, Sequence, Set, TextIO, Tuple, Union
 
 
-def correct_periodic_position(position: Sequence[float], box: Sequence[float]) -> List[float]:
+def correct_periodic_position(position: Sequence[float], box: Sequence[float],
+                              image: Optional[List[int]] = None) -> List[float]:
     """
     Return the given position corrected for periodic boundary conditions in the given simulation box.
 
+    If the image counters of the disk are given, they are updated by the number of box lengths that the position is
+    shifted in each direction. The unwrapped position of the disk is then the corrected position plus the image
+    counters times the box lengths.
+
     Parameters
     ----------
     position : Sequence[float]
         The position vector.
     box : Sequence[float]
         The geometry of the simulation box.
+    image : List[int] or None, optional
+        The image counters of the disk.
 
     Returns
     -------
     List[float]
         The position vector after considering periodic boundary condition.
     """
-    return [p % b for p, b in zip(position, box)]
+    corrected = [p % b for p, b in zip(position, box)]
+    if image is not None:
+        for d in range(len(corrected)):
+            image[d] += round((position[d] - corrected[d]) / box[d])
+    return corrected
 
 
 def separation_vector(position_one: Sequence[float], position_two: Sequence[float],
@@ -165,6 +188,85 @@ def create_packed(n: int, sigma: float, box: Sequence[float]) -> List[List[float
     return pos
 
 
+# The version of the initial configurations in the cache of the create_initial_configuration function. It has to be
+# incremented whenever the create_crystal or create_packed functions, or the format of the cache files change.
+initial_configuration_version = 1
+
+
+def create_initial_configuration(n_x: int, n_y: int, eta: float, shape: str, cache_dir: Optional[str] = None
+                                 ) -> Tuple[float, Tuple[float, float], List[List[float]]]:
+    """
+    Return the radius of the disks, the simulation box, and the initial hard-disk configuration for the given
+    command-line arguments of the sampling programs.
+
+    The box has the area 1. Its aspect ratio is 1 for the square shape, sqrt(3) / 2 for the rectangle shape, and
+    compatible with a triangular lattice of n_y rows with n_x disks each for the crystal shape. The initial
+    configuration is created by the create_packed function for the square and rectangle shapes, and by the
+    create_crystal function for the crystal shape.
+
+    If a cache directory is given, the initial configuration is stored there as a binary array of doubles in a file
+    whose name is the SHA-256 hash of the arguments and of the initial_configuration_version, so that changes of the
+    generated configurations never load stale files. Later calls with the same arguments load the file instead of
+    creating the configuration again. The file is written to a temporary name first and then renamed so that
+    concurrent jobs never read an incomplete file. The sampling programs do not use the cache if the initial
+    configuration is read from a previous run.
+
+    Parameters
+    ----------
+    n_x : int
+        The number of disks per row.
+    n_y : int
+        The number of rows.
+    eta : float
+        The packing fraction.
+    shape : str
+        The shape of the box, 'square', 'rectangle', or 'crystal'.
+    cache_dir : str or None, optional
+        The directory of the cache of initial configurations, or None if no cache is used.
+
+    Returns
+    -------
+    (float, (float, float), List[List[float]])
+        (The radius of the disks, the geometry of the box, the list of the initial two-dimensional hard-disk
+        positions.)
+
+    Raises
+    ------
+    RuntimeError
+        If the hard disks do not fit in the simulation box.
+    """
+    n = n_x * n_y
+    sigma = math.sqrt(eta / (n * math.pi))
+    if shape == "square":
+        aspect_ratio = 1.0
+    elif shape == "rectangle":
+        aspect_ratio = math.sqrt(3.0) / 2.0
+    else:
+        assert shape == "crystal"
+        aspect_ratio = math.sqrt(3.0) / 2.0 * n_y / n_x
+    box = (1.0 / math.sqrt(aspect_ratio), math.sqrt(aspect_ratio))
+    filename = None
+    if cache_dir is not None:
+        key = hashlib.sha256("{0} {1} {2} {3!r} {4}".format(
+            initial_configuration_version, n_x, n_y, eta, shape).encode()).hexdigest()
+        filename = os.path.join(cache_dir, key + ".bin")
+        components = array("d")
+        try:
+            with open(filename, "rb") as file:
+                components.fromfile(file, 2 * n)
+            return sigma, box, [components[2 * k:2 * k + 2].tolist() for k in range(n)]
+        except (OSError, EOFError):
+            pass
+    pos = create_crystal(n_x, n_y, sigma, box) if shape == "crystal" else create_packed(n, sigma, box)
+    if filename is not None:
+        os.makedirs(cache_dir, exist_ok=True)
+        temporary = "{0}.{1}".format(filename, os.getpid())
+        with open(temporary, "wb") as file:
+            array("d", [comp for s in pos for comp in s]).tofile(file)
+        os.replace(temporary, filename)
+    return sigma, box, pos
+
+
 def sample_vel(n: int) -> List[List[float]]:
     """
     Sample n uniformly distributed two-dimensional unit vectors as initial velocities.
@@ -184,3 +286,1557 @@ def sample_vel(n: int) -> List[List[float]]:
         theta = random.uniform(0.0, 2.0 * math.pi)
         vel.append([math.cos(theta), math.sin(theta)])
     return vel
+
+
+def print_pressure(pressures: Sequence[float]) -> None:
+    """
+    Print the mean and the standard error of the given pressures of independent samples, if there are at least two.
+
+    Parameters
+    ----------
+    pressures : Sequence[float]
+        The pressures of the samples.
+    """
+    if len(pressures) < 2:
+        return
+    mean_pressure = sum(pressures) / len(pressures)
+    error_pressure = math.sqrt(sum((p - mean_pressure) ** 2 for p in pressures) / (len(pressures) - 1) / len(pressures))
+    print(r'Pressure: {:+.6f} \pm {:+.6f}'.format(mean_pressure, error_pressure))
+
+
+def add_output_arguments(parser: argparse.ArgumentParser, delta_frames: bool = True, trajectory: bool = True) -> None:
+    """
+    Add the command-line arguments that control the output of the hard-disk configurations to the given parser.
+
+    Parameters
+    ----------
+    parser : argparse.ArgumentParser
+        The command-line argument parser of the sampling program.
+    delta_frames : bool, optional
+        Whether the sampling program moves only few disks between two samples so that delta frames can be written.
+    trajectory : bool, optional
+        Whether the program writes a trajectory of samples so that shards, unwrapped positions, mean-square
+        displacements, and sub-box histograms can be written, or only a single configuration.
+    """
+    if delta_frames:
+        parser.add_argument("-k", "--keyframe_interval",
+                            help="number of samples between two full configurations, the samples in between only "
+                                 "store the disks that moved since the previous sample (default=1)",
+                            default=1, type=int)
+    parser.add_argument("-q", "--quantization_bits", choices=[16, 24],
+                        help="store the positions as integers with the given number of bits relative to the box "
+                             "(default: full precision)",
+                        default=None, type=int)
+    parser.add_argument("-l", "--layout", choices=["interleaved", "columnar"],
+                        help="layout of the positions in a full configuration, interleaved (x_0 y_0 x_1 y_1 ...) or "
+                             "columnar (x_0 x_1 ... y_0 y_1 ...) (default=interleaved)",
+                        default="interleaved", type=str)
+    parser.add_argument("-o", "--output", help="file for the samples (default: stdout)", default=None, type=str)
+    if trajectory:
+        parser.add_argument("--shard_size",
+                            help="number of samples per file, the output file then lists the files in a manifest",
+                            default=None, type=int)
+    parser.add_argument("--checksums", help="append a CRC32 checksum to every sample", action="store_true")
+    parser.add_argument("--fsync_interval",
+                        help="number of samples between two synchronizations of the output file with the disk "
+                             "(default=0, i.e., no explicit synchronization)",
+                        default=0, type=int)
+    if trajectory:
+        parser.add_argument("--unwrapped",
+                            help="store the unwrapped positions, i.e., without periodic boundary conditions",
+                            action="store_true")
+        parser.add_argument("--msd", help="compute the mean-square displacement on lag times of powers of two samples "
+                                          "and append it to the output", action="store_true")
+        parser.add_argument("--subbox_grid",
+                            help="compute histograms of the number of disks in sub-boxes of 1 x 1, 2 x 2, ... cells "
+                                 "of a grid with the given number of cells in x direction, and append them to the "
+                                 "output (default: no histograms)",
+                            default=None, type=int)
+    parser.add_argument("--shared_memory",
+                        help="also publish all samples in a shared-memory ring buffer with the given name",
+                        default=None, type=str)
+    parser.add_argument("--ring_capacity", help="number of samples in the shared-memory ring buffer (default=64)",
+                        default=64, type=int)
+
+
+def add_initial_arguments(parser: argparse.ArgumentParser) -> None:
+    """
+    Add the command-line arguments that control the initial configuration and the checks of the configurations to the
+    given parser.
+
+    Parameters
+    ----------
+    parser : argparse.ArgumentParser
+        The command-line argument parser of the sampling program.
+    """
+    parser.add_argument("--initial",
+                        help="output file of a previous run without quantized positions whose last sample is used as "
+                             "the initial configuration (default: packed or crystalline configuration)",
+                        default=None, type=str)
+    parser.add_argument("--cache_dir",
+                        help="directory of a cache of initial configurations that are reused by later runs with the "
+                             "same n_x, n_y, eta, and shape (default: no cache)",
+                        default=None, type=str)
+    parser.add_argument("--validate_interval",
+                        help="number of samples between two checks that no hard disks overlap (default=0, i.e., only "
+                             "the initial configuration from --initial is checked)",
+                        default=0, type=int)
+
+
+def add_replica_arguments(parser: argparse.ArgumentParser) -> None:
+    """
+    Add the command-line arguments that control the replicas to the given parser.
+
+    Parameters
+    ----------
+    parser : argparse.ArgumentParser
+        The command-line argument parser of the sampling program.
+    """
+    parser.add_argument("--replicas",
+                        help="number of independent runs from the initial configuration in parallel processes, "
+                             "replica k uses the seed seed + k and appends .rk (three digits) to its output files "
+                             "(default=1)",
+                        default=1, type=int)
+
+
+def start_replicas(args: argparse.Namespace) -> int:
+    """
+    Fork the current process into the number of replicas that is given by the command-line arguments that were added
+    by the add_replica_arguments function.
+
+    Every replica is a child process that inherits the initial configuration from the parent. The memory of the parent
+    is shared copy-on-write, i.e., it is only duplicated when a replica modifies it. Before forking, the objects of the
+    parent are frozen in the garbage collector so that garbage collections in the replicas do not touch (and thereby
+    copy) them. Replica k reseeds the random number generator with args.seed + k, and appends '.rk' (with k as three
+    digits) to the output file, to the name of the shared-memory ring buffer, and to the trace file in args. The parent
+    waits for all replicas and exits afterwards, with a non-zero exit status if any replica failed.
+
+    Parameters
+    ----------
+    args : argparse.Namespace
+        The parsed command-line arguments.
+
+    Returns
+    -------
+    int
+        The number of the replica, or 0 if only a single replica is requested and no process is forked.
+
+    Raises
+    ------
+    RuntimeError
+        If several replicas are requested, but no output file is given, or processes cannot be forked.
+    """
+    if args.replicas <= 1:
+        return 0
+    if args.output is None:
+        raise RuntimeError("Several replicas require an output file.")
+    if not hasattr(os, "fork"):
+        raise RuntimeError("Replicas require forking processes, which is not supported on this platform.")
+    sys.stdout.flush()
+    gc.freeze()
+    children = []
+    for replica in range(args.replicas):
+        pid = os.fork()
+        if pid == 0:
+            random.seed(args.seed + replica)
+            for name in ("output", "shared_memory", "trace"):
+                if getattr(args, name, None) is not None:
+                    setattr(args, name, "{0}.r{1:03d}".format(getattr(args, name), replica))
+            return replica
+        children.append(pid)
+    failed = [pid for pid in children if os.waitpid(pid, 0)[1] != 0]
+    sys.exit(1 if failed else 0)
+
+
+class SharedMemoryRing:
+    """
+    Class that publishes hard-disk configurations in a POSIX shared-memory ring buffer, or reads them from it.
+
+    The sampling program creates the ring buffer and publishes every sampled configuration with a consecutive sequence
+    number. Any number of analysis processes can attach to the ring buffer by its name and read the configurations
+    while the sampling program is running. The sampling program never waits for the readers. Once a configuration has
+    been overwritten by a newer one, a reader skips it. A minimal reader looks like:
+
+        ring = SharedMemoryRing.attach("disks")
+        for sequence, configuration in ring.frames():
+            ...
+
+    The shared memory contains 64-bit words. The header consists of the number of position components per
+    configuration (2 * n), the number of slots, and the sequence number of the next published configuration. Each slot
+    stores a sequence number, the position components, and the sequence number again. The writer invalidates the first
+    sequence number before overwriting a slot and sets both sequence numbers afterwards. A reader copies a slot and
+    accepts the copy only if both sequence numbers equal the expected one.
+
+    Attributes
+    ----------
+    memory : multiprocessing.shared_memory.SharedMemory
+        The shared-memory block.
+    words : memoryview
+        The shared memory as 64-bit integers.
+    components : memoryview
+        The shared memory as 64-bit floats.
+    frame_size : int
+        The number of position components per configuration.
+    capacity : int
+        The number of slots of the ring buffer.
+    owner : bool
+        Whether this instance created the shared-memory block.
+    """
+    header_size = 3
+
+    def __init__(self, memory: shared_memory.SharedMemory, owner: bool):
+        """
+        Initialize the instance for the given shared-memory block, whose header has to be initialized already.
+
+        Parameters
+        ----------
+        memory : multiprocessing.shared_memory.SharedMemory
+            The shared-memory block.
+        owner : bool
+            Whether this instance created the shared-memory block.
+        """
+        self.memory = memory
+        self.owner = owner
+        self.words = memory.buf.cast("q")
+        self.components = memory.buf.cast("d")
+        self.frame_size = self.words[0]
+        self.capacity = self.words[1]
+
+    @classmethod
+    def create(cls, name: str, frame_size: int, capacity: int) -> "SharedMemoryRing":
+        """
+        Create a new shared-memory ring buffer.
+
+        Parameters
+        ----------
+        name : str
+            The name of the shared-memory block.
+        frame_size : int
+            The number of position components per configuration.
+        capacity : int
+            The number of slots of the ring buffer.
+
+        Returns
+        -------
+        SharedMemoryRing
+            The ring buffer.
+        """
+        memory = shared_memory.SharedMemory(name=name, create=True,
+                                            size=8 * (cls.header_size + capacity * (frame_size + 2)))
+        words = memory.buf.cast("q")
+        words[0] = frame_size
+        words[1] = capacity
+        words[2] = 0
+        for slot in range(capacity):
+            words[cls.header_size + slot * (frame_size + 2)] = -1
+        words.release()
+        return cls(memory, True)
+
+    @classmethod
+    def attach(cls, name: str) -> "SharedMemoryRing":
+        """
+        Attach to an existing shared-memory ring buffer.
+
+        Parameters
+        ----------
+        name : str
+            The name of the shared-memory block.
+
+        Returns
+        -------
+        SharedMemoryRing
+            The ring buffer.
+        """
+        memory = shared_memory.SharedMemory(name=name)
+        # Before Python 3.13, attaching registers the block with the resource tracker of this process, which would
+        # remove it when this process ends although the sampling program still uses it. The tracker knows the block
+        # under its POSIX name, which has a leading slash that the name attribute omits.
+        resource_tracker.unregister("/" + memory.name.lstrip("/"), "shared_memory")
+        return cls(memory, False)
+
+    def publish(self, configuration: Sequence[float]) -> None:
+        """
+        Publish the given hard-disk configuration with the next sequence number.
+
+        Parameters
+        ----------
+        configuration : Sequence[float]
+            The position components of all hard disks.
+        """
+        sequence = self.words[2]
+        start = self.header_size + (sequence % self.capacity) * (self.frame_size + 2)
+        self.words[start] = -1
+        self.components[start + 1:start + 1 + self.frame_size] = array("d", configuration)
+        self.words[start + 1 + self.frame_size] = sequence
+        self.words[start] = sequence
+        self.words[2] = sequence + 1
+
+    def read(self, sequence: int) -> Optional[List[float]]:
+        """
+        Return a copy of the hard-disk configuration with the given sequence number.
+
+        Parameters
+        ----------
+        sequence : int
+            The sequence number.
+
+        Returns
+        -------
+        List[float] or None
+            The position components of all hard disks, or None if the configuration is not (or no longer) available.
+        """
+        start = self.header_size + (sequence % self.capacity) * (self.frame_size + 2)
+        if self.words[start] != sequence:
+            return None
+        configuration = self.components[start + 1:start + 1 + self.frame_size].tolist()
+        if self.words[start] != sequence or self.words[start + 1 + self.frame_size] != sequence:
+            return None
+        return configuration
+
+    def frames(self, sequence: Optional[int] = None,
+               poll_interval: float = 0.01) -> Iterator[Tuple[int, List[float]]]:
+        """
+        Yield the sequence numbers and the hard-disk configurations published in the ring buffer, starting with the
+        given sequence number. This generator waits for new configurations and never stops on its own.
+
+        If the reader falls behind by more than the capacity of the ring buffer, the overwritten configurations are
+        skipped.
+
+        Parameters
+        ----------
+        sequence : int or None, optional
+            The sequence number of the first configuration, or None to start with the oldest available one.
+        poll_interval : float, optional
+            The time in seconds to wait before checking for a new configuration again.
+
+        Yields
+        ------
+        (int, List[float])
+            (The sequence number, the position components of all hard disks.)
+        """
+        if sequence is None:
+            sequence = max(self.words[2] - self.capacity, 0)
+        while True:
+            if sequence >= self.words[2]:
+                time.sleep(poll_interval)
+                continue
+            sequence = max(sequence, self.words[2] - self.capacity)
+            configuration = self.read(sequence)
+            if configuration is not None:
+                yield sequence, configuration
+            sequence += 1
+
+    def close(self) -> None:
+        """Detach from the shared-memory block, and remove it if this instance created it."""
+        self.words.release()
+        self.components.release()
+        self.memory.close()
+        if self.owner:
+            self.memory.unlink()
+
+
+class MeanSquareDisplacement:
+    """
+    Streaming accumulator of the mean-square displacement of the hard disks on logarithmic lag times.
+
+    The lag times are the powers of two 1, 2, 4, ... in units of configurations. For the lag time 2 ** l, the
+    configurations at the multiples of 2 ** l serve as time origins. Only the last such configuration has to be stored
+    for every lag time, so that the memory grows logarithmically with the number of configurations, and the cost per
+    configuration is amortized constant. The displacements are measured relative to the displacement of the center of
+    mass, which drifts in event-chain Monte Carlo because all chains move the disks in the direction of the velocity.
+
+    Attributes
+    ----------
+    count : int
+        The number of added configurations.
+    first : List[Tuple[float, float]] or None
+        The first configuration.
+    references : List[List[Tuple[float, float]]]
+        The last configuration at a multiple of 2 ** l for every lag time 2 ** l that was reached.
+    sums : List[float]
+        The sum of the mean-square displacements for every lag time.
+    counts : List[int]
+        The number of time origins for every lag time.
+    """
+    def __init__(self):
+        """Initialize the instance."""
+        self.count = 0
+        self.first = None
+        self.references = []
+        self.sums = []
+        self.counts = []
+
+    def add(self, pos: Sequence[Sequence[float]]) -> None:
+        """
+        Add the given configuration with unwrapped positions.
+
+        Parameters
+        ----------
+        pos : Sequence[Sequence[float]]
+            The unwrapped positions of all hard disks.
+        """
+        configuration = [(s[0], s[1]) for s in pos]
+        if self.first is None:
+            self.first = configuration
+        level = 0
+        while self.count > 0 and self.count % (1 << level) == 0:
+            reference = self.references[level] if level < len(self.references) else self.first
+            displacements = [(s[0] - r[0], s[1] - r[1]) for s, r in zip(configuration, reference)]
+            mean_x = sum(d[0] for d in displacements) / len(displacements)
+            mean_y = sum(d[1] for d in displacements) / len(displacements)
+            msd = sum((d[0] - mean_x) ** 2 + (d[1] - mean_y) ** 2 for d in displacements) / len(displacements)
+            if level < len(self.references):
+                self.references[level] = configuration
+                self.sums[level] += msd
+                self.counts[level] += 1
+            else:
+                self.references.append(configuration)
+                self.sums.append(msd)
+                self.counts.append(1)
+            level += 1
+        self.count += 1
+
+    def results(self) -> List[Tuple[int, float, int]]:
+        """
+        Return the mean-square displacement for every lag time that was reached.
+
+        Returns
+        -------
+        List[(int, float, int)]
+            The lag time in configurations, the mean-square displacement, and the number of time origins.
+        """
+        return [(1 << level, total / count, count)
+                for level, (total, count) in enumerate(zip(self.sums, self.counts))]
+
+
+def find_overlaps(pos: Sequence[Sequence[float]], sigma: float, box: Sequence[float], periodic: bool = True,
+                  tolerance: float = 1.0e-9) -> List[Tuple[int, int]]:
+    """
+    Return all pairs of overlapping hard disks in the given configuration.
+
+    The disks are sorted into a grid of cells with side lengths of at least 2 * sigma, so that overlapping disks are
+    located in the same or in neighboring cells. The cost is therefore O(N) instead of O(N^2) for a comparison of all
+    pairs. In a box with periodic boundary conditions, the cells at opposite sides of the box are neighbors. In a box
+    with walls, a disk that overlaps with a wall is reported as the pair (k, -1).
+
+    Event-chain Monte Carlo places disks at contact up to rounding errors. Two disks thus only overlap if their
+    distance is smaller than 2 * sigma * sqrt(1 - tolerance).
+
+    Parameters
+    ----------
+    pos : Sequence[Sequence[float]]
+        The positions of all hard disks.
+    sigma : float
+        The radius of the hard disks.
+    box : Sequence[float]
+        The geometry of the simulation box.
+    periodic : bool, optional
+        Whether the box has periodic boundary conditions (or walls).
+    tolerance : float, optional
+        The relative tolerance of the squared contact distance.
+
+    Returns
+    -------
+    List[Tuple[int, int]]
+        The sorted pairs (k, l) with k < l of overlapping disks, and the pairs (k, -1) of disks overlapping a wall.
+    """
+    shape = [max(int(b / (2.0 * sigma)), 1) for b in box]
+    cells = [[[] for _ in range(shape[1])] for _ in range(shape[0])]
+    for k, position in enumerate(pos):
+        i = min(max(int(position[0] / box[0] * shape[0]), 0), shape[0] - 1)
+        j = min(max(int(position[1] / box[1] * shape[1]), 0), shape[1] - 1)
+        cells[i][j].append(k)
+    limit = 4.0 * sigma ** 2 * (1.0 - tolerance)
+    overlaps = []
+    for i in range(shape[0]):
+        for j in range(shape[1]):
+            neighbors = set()
+            for ni in range(i - 1, i + 2):
+                for nj in range(j - 1, j + 2):
+                    if periodic:
+                        neighbors.add((ni % shape[0], nj % shape[1]))
+                    elif 0 <= ni < shape[0] and 0 <= nj < shape[1]:
+                        neighbors.add((ni, nj))
+            for k in cells[i][j]:
+                for ni, nj in neighbors:
+                    for m in cells[ni][nj]:
+                        if m > k:
+                            if periodic:
+                                separation = separation_vector(pos[k], pos[m], box)
+                            else:
+                                separation = [pos[k][0] - pos[m][0], pos[k][1] - pos[m][1]]
+                            if separation[0] ** 2 + separation[1] ** 2 < limit:
+                                overlaps.append((k, m))
+    if not periodic:
+        wall = sigma * math.sqrt(1.0 - tolerance)
+        overlaps.extend((k, -1) for k, position in enumerate(pos)
+                        if any(p < wall or p > b - wall for p, b in zip(position, box)))
+    return sorted(overlaps)
+
+
+def validate_configuration(pos: Sequence[Sequence[float]], sigma: float, box: Sequence[float],
+                           periodic: bool = True) -> None:
+    """
+    Check that no hard disks overlap in the given configuration (see the find_overlaps function).
+
+    Parameters
+    ----------
+    pos : Sequence[Sequence[float]]
+        The positions of all hard disks.
+    sigma : float
+        The radius of the hard disks.
+    box : Sequence[float]
+        The geometry of the simulation box.
+    periodic : bool, optional
+        Whether the box has periodic boundary conditions (or walls).
+
+    Raises
+    ------
+    RuntimeError
+        If any hard disks overlap.
+    """
+    overlaps = find_overlaps(pos, sigma, box, periodic)
+    if overlaps:
+        raise RuntimeError("The configuration contains {0} overlaps, the first ones (-1 denotes a wall) are "
+                           "{1}.".format(len(overlaps), overlaps[:5]))
+
+
+def cell_counts(pos: Sequence[Sequence[float]], box: Sequence[float], shape: Sequence[int]) -> List[List[int]]:
+    """
+    Return the number of hard disks in every cell of a grid of the given shape that covers the simulation box.
+
+    Parameters
+    ----------
+    pos : Sequence[Sequence[float]]
+        The positions of all hard disks in the box.
+    box : Sequence[float]
+        The geometry of the simulation box.
+    shape : Sequence[int]
+        The number of cells in x and in y direction.
+
+    Returns
+    -------
+    List[List[int]]
+        The number of disks in the cell (i, j) at the index [i][j].
+    """
+    counts = [[0] * shape[1] for _ in range(shape[0])]
+    for position in pos:
+        i = min(int(position[0] / box[0] * shape[0]), shape[0] - 1)
+        j = min(int(position[1] / box[1] * shape[1]), shape[1] - 1)
+        counts[i][j] += 1
+    return counts
+
+
+def periodic_prefix_sums(counts: Sequence[Sequence[int]]) -> List[List[int]]:
+    """
+    Return the two-dimensional prefix sums of the given periodic grid of cell counts.
+
+    The grid is repeated once in every direction so that the sum over any block of at most the grid shape, including
+    blocks that wrap around the periodic boundaries, follows from four entries of the prefix sums. The entry [i][j] is
+    the sum over all cells (i', j') with i' < i and j' < j of the repeated grid.
+
+    Parameters
+    ----------
+    counts : Sequence[Sequence[int]]
+        The cell counts of the grid (see the cell_counts function).
+
+    Returns
+    -------
+    List[List[int]]
+        The prefix sums of shape (2 * shape[0] + 1, 2 * shape[1] + 1).
+    """
+    shape = (len(counts), len(counts[0]))
+    sums = [[0] * (2 * shape[1] + 1)]
+    for i in range(2 * shape[0]):
+        row = counts[i % shape[0]]
+        previous = sums[-1]
+        current = [0]
+        running = 0
+        for j in range(2 * shape[1]):
+            running += row[j % shape[1]]
+            current.append(previous[j + 1] + running)
+        sums.append(current)
+    return sums
+
+
+class SubBoxDensity:
+    """
+    Streaming accumulator of the distribution of the number of hard disks in sub-boxes of several sizes.
+
+    The simulation box is covered by a grid of cells. For every sub-box size of s x s cells (s = 1, 2, ..., up to half
+    the smaller grid dimension), and for every cell as the lower left corner of the sub-box (with periodic boundary
+    conditions), the number of disks in the sub-box is entered in a histogram. The number of disks in a sub-box follows
+    from the two-dimensional prefix sums of the cell counts (see the periodic_prefix_sums function), so that the cost
+    per configuration is O(N + cells) for every sub-box size, without any loop over pairs of disks. A bimodal
+    histogram indicates the coexistence of two phases of different densities.
+
+    Attributes
+    ----------
+    box : Sequence[float]
+        The geometry of the simulation box.
+    shape : Tuple[int, int]
+        The number of cells in x and in y direction.
+    sizes : range
+        The side lengths of the sub-boxes in cells.
+    histograms : List[List[int]]
+        For every sub-box size, the number of sub-boxes with k disks at the index k.
+    """
+    def __init__(self, box: Sequence[float], cells_x: int):
+        """
+        Initialize the instance.
+
+        The number of cells in y direction is chosen so that the cells are as close to squares as possible.
+
+        Parameters
+        ----------
+        box : Sequence[float]
+            The geometry of the simulation box.
+        cells_x : int
+            The number of cells in x direction.
+
+        Raises
+        ------
+        RuntimeError
+            If the grid has fewer than two cells in some direction.
+        """
+        self.box = box
+        self.shape = (cells_x, max(round(cells_x * box[1] / box[0]), 1))
+        if min(self.shape) < 2:
+            raise RuntimeError("The grid of the sub-box histograms needs at least two cells in every direction.")
+        self.sizes = range(1, min(self.shape) // 2 + 1)
+        self.histograms = [[] for _ in self.sizes]
+
+    def add(self, pos: Sequence[Sequence[float]]) -> None:
+        """
+        Add the sub-boxes of the given configuration to the histograms.
+
+        Parameters
+        ----------
+        pos : Sequence[Sequence[float]]
+            The positions of all hard disks in the box.
+        """
+        sums = periodic_prefix_sums(cell_counts(pos, self.box, self.shape))
+        for size, histogram in zip(self.sizes, self.histograms):
+            for i in range(self.shape[0]):
+                lower = sums[i]
+                upper = sums[i + size]
+                for j in range(self.shape[1]):
+                    count = upper[j + size] - lower[j + size] - upper[j] + lower[j]
+                    if count >= len(histogram):
+                        histogram.extend([0] * (count + 1 - len(histogram)))
+                    histogram[count] += 1
+
+    def results(self) -> List[Tuple[int, float, List[int]]]:
+        """
+        Return the histogram for every sub-box size.
+
+        Returns
+        -------
+        List[(int, float, List[int])]
+            The side length of the sub-boxes in cells, the area of the sub-boxes, and the histogram of the number of
+            disks in the sub-boxes.
+        """
+        cell_area = self.box[0] / self.shape[0] * self.box[1] / self.shape[1]
+        return [(size, size ** 2 * cell_area, histogram) for size, histogram in zip(self.sizes, self.histograms)]
+
+
+class ConfigurationWriter:
+    """
+    Class that prints hard-disk configurations to stdout or to files in the output format of the sampling programs.
+
+    Each line of the output contains a single hard-disk configuration. A keyframe line contains the positions of all
+    disks. The (2 * k)th and (2 * k + 1)th floats in the line are the x- and y-positions of the kth disk, respectively.
+    Every keyframe_interval configurations, a keyframe is written. The lines in between are delta frames that start
+    with the letter 'd', followed by the triples (k, x, y) of the index and the new position of every disk that moved
+    since the previous configuration. The configuration of a delta frame is reconstructed by applying all delta frames
+    since the last keyframe in order (see the stream_configurations function).
+
+    Lines starting with '#' form the header of the output and store the metadata of the configurations. If the
+    positions are quantized to b bits, the header line '# quantization b L_x L_y max_error' is printed. Every position
+    component x in [0, L) is then stored as the integer q = floor(x / L * 2 ** b), and it is restored as
+    (q + 0.5) * L / 2 ** b. The restored position differs from the true one by at most max_error = L / 2 ** (b + 1) in
+    each component. In the columnar layout, the header line '# layout columnar' is printed, and a keyframe line
+    contains the x-positions of all disks followed by their y-positions. Delta frames are not affected by the layout.
+
+    If checksums are requested, the header line '# checksums crc32' is printed, and every configuration line ends
+    with the token '*c', where c is the CRC32 checksum of the preceding part of the line as eight hexadecimal
+    digits. Together with the terminating newline, this allows readers to detect a configuration that was only
+    partially written when the sampling program was killed. Every fsync_interval configurations, the output file is
+    flushed and synchronized with the disk so that at most these configurations are lost in a crash of the machine,
+    without the cost of synchronizing every configuration.
+
+    If a shard size is given, the output is split into files (shards) with the names output + '.00000',
+    output + '.00001', and so on, each of which contains shard_size configurations. Every shard starts with the header
+    and a keyframe so that it can be read independently of the other shards. The output file itself becomes a
+    manifest that starts with the line '# manifest', followed by the names of the shards in order. The manifest is
+    updated whenever a new shard is started. If the output file is synchronized with the disk, the manifest and its
+    directory are synchronized after every update as well, so that a crash cannot leave shards on the disk that are
+    missing from the manifest. Readers treat the manifest as a single sequence of configurations.
+
+    If unwrapped positions are requested, the header line '# unwrapped L_x L_y' is printed, and the positions are
+    stored without periodic boundary conditions, i.e., as the position in the box plus the image counters of the disk
+    times the box lengths. If the mean-square displacement is requested, it is accumulated from the unwrapped positions
+    (see the MeanSquareDisplacement class), and appended to the output as the lines '# msd lag msd origins' when the
+    writer is closed. Both require the image counters of all disks in the write method. If a sub-box grid is given, the
+    histograms of the number of disks in sub-boxes of several sizes are accumulated (see the SubBoxDensity class), and
+    appended to the output as the lines '# subbox s area h_0 h_1 ...' when the writer is closed, where h_k is the
+    number of sub-boxes of s x s cells with k disks.
+
+    If a shared-memory name is given, every configuration is also published with full precision in a shared-memory
+    ring buffer of that name (see the SharedMemoryRing class) so that other processes can analyze it while the
+    sampling program is running.
+
+    The output is decoded by the stream_configurations and read_configuration functions. The script
+    Python/four-disk/fitting.py uses the same functions, but its pressure estimators only apply to four disks in a box
+    with walls. They cannot analyze the periodic configurations of the sampling programs in this directory.
+
+    Attributes
+    ----------
+    box : Sequence[float]
+        The geometry of the simulation box.
+    keyframe_interval : int
+        The number of configurations between two keyframes.
+    quantization_bits : int or None
+        The number of bits of the quantized position components, or None if the positions are printed as floats.
+    layout : str
+        The layout of the positions in a keyframe, 'interleaved' or 'columnar'.
+    output : str or None
+        The name of the output file, or None if the configurations are printed to stdout.
+    shard_size : int or None
+        The number of configurations per shard, or None if the output is not split into shards.
+    checksums : bool
+        Whether a checksum is appended to every configuration line.
+    fsync_interval : int
+        The number of configurations between two synchronizations of the output file with the disk, or 0.
+    header : List[str]
+        The header lines of the output.
+    file : TextIO or None
+        The file that the configurations are currently printed to.
+    manifest : TextIO or None
+        The manifest file if the output is split into shards.
+    shared_memory_name : str or None
+        The name of the shared-memory ring buffer, or None if the configurations are not published.
+    ring_capacity : int
+        The number of configurations in the shared-memory ring buffer.
+    ring : SharedMemoryRing or None
+        The shared-memory ring buffer, or None if the configurations are not published.
+    frame_count : int
+        The number of written configurations.
+    unwrapped : bool
+        Whether the unwrapped positions are printed.
+    msd : MeanSquareDisplacement or None
+        The accumulator of the mean-square displacement, or None if it is not computed.
+    subbox : SubBoxDensity or None
+        The accumulator of the sub-box histograms, or None if they are not computed.
+    """
+    def __init__(self, box: Sequence[float], n: int, keyframe_interval: int = 1,
+                 quantization_bits: Optional[int] = None, layout: str = "interleaved", output: Optional[str] = None,
+                 shard_size: Optional[int] = None, checksums: bool = False, fsync_interval: int = 0,
+                 shared_memory_name: Optional[str] = None, ring_capacity: int = 64, unwrapped: bool = False,
+                 msd: bool = False, subbox_grid: Optional[int] = None):
+        """
+        Initialize the instance, print the header of the output, and create the shared-memory ring buffer so that
+        readers can attach before the first configuration is published.
+
+        Parameters
+        ----------
+        box : Sequence[float]
+            The geometry of the simulation box.
+        n : int
+            The number of hard disks.
+        keyframe_interval : int, optional
+            The number of configurations between two keyframes.
+        quantization_bits : int or None, optional
+            The number of bits of the quantized position components, or None if the positions are printed as floats.
+        layout : str, optional
+            The layout of the positions in a keyframe, 'interleaved' or 'columnar'.
+        output : str or None, optional
+            The name of the output file, or None if the configurations are printed to stdout.
+        shard_size : int or None, optional
+            The number of configurations per shard, or None if the output is not split into shards.
+        checksums : bool, optional
+            Whether a checksum is appended to every configuration line.
+        fsync_interval : int, optional
+            The number of configurations between two synchronizations of the output file with the disk, or 0.
+        shared_memory_name : str or None, optional
+            The name of the shared-memory ring buffer, or None if the configurations are not published.
+        ring_capacity : int, optional
+            The number of configurations in the shared-memory ring buffer.
+        unwrapped : bool, optional
+            Whether the unwrapped positions are printed.
+        msd : bool, optional
+            Whether the mean-square displacement is computed.
+        subbox_grid : int or None, optional
+            The number of cells in x direction of the grid of the sub-box histograms, or None if they are not computed.
+
+        Raises
+        ------
+        RuntimeError
+            If the keyframe interval or the shard size is not positive, if shards are requested without an output
+            file, or if unwrapped positions are requested together with quantized positions.
+        """
+        if keyframe_interval < 1:
+            raise RuntimeError("The keyframe interval has to be positive.")
+        if shard_size is not None and (shard_size < 1 or output is None):
+            raise RuntimeError("Sharded output requires a positive shard size and an output file.")
+        if unwrapped and quantization_bits is not None:
+            raise RuntimeError("Unwrapped positions cannot be quantized relative to the box.")
+        self.box = box
+        self.keyframe_interval = keyframe_interval
+        self.quantization_bits = quantization_bits
+        self.layout = layout
+        self.output = output
+        self.shard_size = shard_size
+        self.checksums = checksums
+        self.fsync_interval = fsync_interval
+        self.shared_memory_name = shared_memory_name
+        self.ring_capacity = ring_capacity
+        self.ring = (SharedMemoryRing.create(shared_memory_name, 2 * n, ring_capacity)
+                     if shared_memory_name is not None else None)
+        self.frame_count = 0
+        self.unwrapped = unwrapped
+        self.msd = MeanSquareDisplacement() if msd else None
+        self.subbox = SubBoxDensity(box, subbox_grid) if subbox_grid is not None else None
+        self.header = []
+        if quantization_bits is not None:
+            self.header.append("# quantization {0} {1} {2} {3}".format(
+                quantization_bits, *box, max(box) / 2 ** (quantization_bits + 1)))
+        if layout == "columnar":
+            self.header.append("# layout {0}".format(layout))
+        if checksums:
+            self.header.append("# checksums crc32")
+        if unwrapped:
+            self.header.append("# unwrapped {0} {1}".format(*box))
+        self.manifest = None
+        if shard_size is not None:
+            self.file = None
+            self.manifest = open(output, "w")
+            print("# manifest", file=self.manifest, flush=True)
+            if fsync_interval > 0:
+                self.synchronize_manifest()
+        else:
+            self.file = sys.stdout if output is None else open(output, "w")
+            for line in self.header:
+                print(line, file=self.file)
+
+    @classmethod
+    def from_arguments(cls, args: argparse.Namespace, box: Sequence[float], n: int) -> "ConfigurationWriter":
+        """
+        Create a writer from the command-line arguments that were added by the add_output_arguments function.
+
+        Parameters
+        ----------
+        args : argparse.Namespace
+            The parsed command-line arguments.
+        box : Sequence[float]
+            The geometry of the simulation box.
+        n : int
+            The number of hard disks.
+
+        Returns
+        -------
+        ConfigurationWriter
+            The writer.
+        """
+        return cls(box, n, getattr(args, "keyframe_interval", 1), args.quantization_bits, args.layout, args.output,
+                   getattr(args, "shard_size", None), args.checksums, args.fsync_interval, args.shared_memory,
+                   args.ring_capacity, getattr(args, "unwrapped", False), getattr(args, "msd", False),
+                   getattr(args, "subbox_grid", None))
+
+    def format_position(self, position: Sequence[float]) -> Sequence[Union[float, int]]:
+        """
+        Return the given position in the format of the output.
+
+        Parameters
+        ----------
+        position : Sequence[float]
+            The position vector.
+
+        Returns
+        -------
+        Sequence[float or int]
+            The position vector, or the quantized position components if the output is quantized.
+        """
+        if self.quantization_bits is None:
+            return position
+        levels = 2 ** self.quantization_bits
+        return [min(int(p / b * levels), levels - 1) for p, b in zip(position, self.box)]
+
+    def write(self, pos: Sequence[Sequence[float]], moved: Optional[Set[int]] = None,
+              images: Optional[Sequence[Sequence[int]]] = None) -> None:
+        """
+        Print the given hard-disk configuration.
+
+        If the set of the disks that moved since the previous configuration is given, and no keyframe is due, only
+        these disks are printed in a delta frame. The set is cleared afterwards. If the output is split into shards and
+        the current shard is full, a new shard is started with a keyframe.
+
+        Parameters
+        ----------
+        pos : Sequence[Sequence[float]]
+            The positions of all hard disks.
+        moved : Set[int] or None, optional
+            The indices of the disks that moved since the previous configuration.
+        images : Sequence[Sequence[int]] or None, optional
+            The image counters of all hard disks (see the correct_periodic_position function).
+
+        Raises
+        ------
+        RuntimeError
+            If unwrapped positions or the mean-square displacement are requested, but no image counters are given.
+        """
+        published = pos
+        if self.subbox is not None:
+            self.subbox.add(pos)
+        if self.unwrapped or self.msd is not None:
+            if images is None:
+                raise RuntimeError("Unwrapped positions require the image counters of the hard disks.")
+            unwrapped = [[p + i * b for p, i, b in zip(s, image, self.box)] for s, image in zip(pos, images)]
+            if self.msd is not None:
+                self.msd.add(unwrapped)
+            if self.unwrapped:
+                pos = unwrapped
+        keyframe = moved is None or self.frame_count % self.keyframe_interval == 0
+        if self.shard_size is not None and self.frame_count % self.shard_size == 0:
+            self.open_shard(self.frame_count // self.shard_size)
+            keyframe = True
+        if keyframe:
+            if self.layout == "columnar":
+                positions = [self.format_position(s) for s in pos]
+                line = " ".join(map(str, [*iter(s[0] for s in positions), *iter(s[1] for s in positions)]))
+            else:
+                line = " ".join(map(str, iter(comp for s in pos for comp in self.format_position(s))))
+        else:
+            line = " ".join(map(str, ["d", *iter(comp for k in sorted(moved) for comp in
+                                                 (k, *self.format_position(pos[k])))]))
+        if self.checksums:
+            line += " *{0:08x}".format(zlib.crc32(line.encode()))
+        print(line, file=self.file)
+        if self.fsync_interval > 0 and (self.frame_count + 1) % self.fsync_interval == 0:
+            self.synchronize()
+        if moved is not None:
+            moved.clear()
+        if self.ring is not None:
+            self.ring.publish([comp for s in published for comp in s])
+        self.frame_count += 1
+
+    def synchronize(self) -> None:
+        """Flush the current output file and synchronize it with the disk (not possible for pipes or terminals)."""
+        self.file.flush()
+        try:
+            os.fsync(self.file.fileno())
+        except OSError:
+            pass
+
+    def open_shard(self, shard: int) -> None:
+        """
+        Close the current shard, start the shard with the given number, and add it to the manifest.
+
+        Parameters
+        ----------
+        shard : int
+            The number of the shard.
+        """
+        if self.file is not None:
+            if self.fsync_interval > 0:
+                self.synchronize()
+            self.file.close()
+        filename = "{0}.{1:05d}".format(self.output, shard)
+        self.file = open(filename, "w")
+        for line in self.header:
+            print(line, file=self.file)
+        print(os.path.basename(filename), file=self.manifest, flush=True)
+        if self.fsync_interval > 0:
+            self.synchronize_manifest()
+
+    def synchronize_manifest(self) -> None:
+        """
+        Flush the manifest and synchronize it and its directory, which contains the entries of the shards, with the
+        disk (the directory is not synchronized on platforms that cannot open directories).
+        """
+        self.manifest.flush()
+        os.fsync(self.manifest.fileno())
+        try:
+            directory = os.open(os.path.dirname(os.path.abspath(self.output)), os.O_RDONLY)
+        except OSError:
+            return
+        try:
+            os.fsync(directory)
+        finally:
+            os.close(directory)
+
+    def close(self) -> None:
+        """
+        Finish the output, close the output files, and remove the shared-memory ring buffer.
+
+        If the mean-square displacement or the sub-box histograms are computed, they are printed before the output file
+        is closed.
+        """
+        if self.msd is not None and self.file is not None:
+            for lag, msd, origins in self.msd.results():
+                print("# msd {0} {1} {2}".format(lag, msd, origins), file=self.file)
+        if self.subbox is not None and self.file is not None:
+            for size, area, histogram in self.subbox.results():
+                print("# subbox {0} {1}".format(size, area), *histogram, file=self.file)
+        if self.file is not None and self.fsync_interval > 0:
+            self.synchronize()
+        if self.file is not None and self.file is not sys.stdout:
+            self.file.close()
+        self.file = None
+        if self.manifest is not None:
+            self.manifest.close()
+            self.manifest = None
+        if self.ring is not None:
+            self.ring.close()
+            self.ring = None
+
+
+def parse_header_line(line: bytes, header: Dict[str, List[str]]) -> None:
+    """
+    Store the values of the given header line '# key value ...' of an output file in the given dictionary.
+
+    Parameters
+    ----------
+    line : bytes
+        The header line.
+    header : Dict[str, List[str]]
+        The values of each key in the header.
+    """
+    tokens = line[1:].decode().split()
+    if tokens:
+        header[tokens[0]] = tokens[1:]
+
+
+def position_scale(header: Dict[str, List[str]]) -> Optional[List[float]]:
+    """
+    Return the size of a quantization level in each direction for the given header of an output file.
+
+    Parameters
+    ----------
+    header : Dict[str, List[str]]
+        The values of each key in the header.
+
+    Returns
+    -------
+    List[float] or None
+        The sizes of a quantization level, or None if the positions are not quantized.
+    """
+    if "quantization" not in header:
+        return None
+    bits, box_x, box_y = header["quantization"][:3]
+    return [float(box_x) / 2 ** int(bits), float(box_y) / 2 ** int(bits)]
+
+
+def check_line(line: bytes, checksums: bool = False) -> bool:
+    """
+    Return whether the given configuration line of an output file was written completely.
+
+    A complete line ends with a newline. If the line ends with a checksum token '*c', c has to be the CRC32 checksum of
+    the preceding part of the line in hexadecimal digits. If the header of the output file contains the line
+    '# checksums crc32', the checksum token is required.
+
+    Parameters
+    ----------
+    line : bytes
+        The configuration line.
+    checksums : bool, optional
+        Whether the line must end with a checksum token.
+
+    Returns
+    -------
+    bool
+        Whether the line is complete.
+    """
+    if not line.endswith(b"\n"):
+        return False
+    content, separator, checksum = line.rstrip().rpartition(b" *")
+    if not separator:
+        return not checksums
+    try:
+        return zlib.crc32(content) == int(checksum, 16)
+    except ValueError:
+        return False
+
+
+def parse_configuration(line: bytes, previous: Sequence[float], scale: Optional[Sequence[float]] = None,
+                        columnar: bool = False) -> List[float]:
+    """
+    Return the hard-disk configuration that is stored in the given configuration line of an output file.
+
+    A keyframe line contains the positions of all hard disks. A delta frame line starts with the letter 'd', followed
+    by the triples (k, x, y) of the index and the new position of every disk that moved since the previous
+    configuration. The positions of all other disks are taken from the given previous configuration.
+
+    If the positions are quantized, each position component is stored as an integer q and restored as
+    (q + 0.5) * scale[d], where d is the direction of the component (see the position_scale function).
+
+    In the columnar layout, a keyframe line contains the x-positions of all disks followed by their y-positions. The
+    returned configuration is always in the interleaved layout, i.e., the (2 * k)th and (2 * k + 1)th floats are the
+    x- and y-positions of the kth disk. A checksum token at the end of the line is verified and removed.
+
+    Parameters
+    ----------
+    line : bytes
+        The configuration line.
+    previous : Sequence[float]
+        The previous hard-disk configuration (only used for delta frames).
+    scale : Sequence[float] or None, optional
+        The sizes of a quantization level in each direction, or None if the positions are not quantized.
+    columnar : bool, optional
+        Whether keyframe lines are in the columnar layout.
+
+    Returns
+    -------
+    List[float]
+        The hard-disk configuration.
+
+    Raises
+    ------
+    RuntimeError
+        If the checksum of the line is wrong.
+    """
+    tokens = line.split()
+    if tokens[-1].startswith(b"*"):
+        if not check_line(line.rstrip() + b"\n"):
+            raise RuntimeError("The configuration line {0!r} has a wrong checksum.".format(line[:40]))
+        tokens.pop()
+    if tokens[0] != b"d":
+        if columnar:
+            half = len(tokens) // 2
+            tokens = [token for pair in zip(tokens[:half], tokens[half:]) for token in pair]
+        if scale is None:
+            return list(map(float, tokens))
+        return [(int(q) + 0.5) * scale[i % 2] for i, q in enumerate(tokens)]
+    configuration = list(previous)
+    for i in range(1, len(tokens), 3):
+        k = int(tokens[i])
+        if scale is None:
+            configuration[2 * k] = float(tokens[i + 1])
+            configuration[2 * k + 1] = float(tokens[i + 2])
+        else:
+            configuration[2 * k] = (int(tokens[i + 1]) + 0.5) * scale[0]
+            configuration[2 * k + 1] = (int(tokens[i + 2]) + 0.5) * scale[1]
+    return configuration
+
+
+def stream_configurations(file: BinaryIO, header: Dict[str, List[str]]) -> Iterator[List[float]]:
+    """
+    Yield the hard-disk configurations of the given output file (or of a possibly unbounded stream, e.g., stdin) in
+    order.
+
+    Delta frames, quantized positions, and the columnar layout are decoded according to the header lines, which are
+    stored in the given dictionary as they arrive (see the parse_configuration function). The configurations are
+    always yielded in the interleaved layout. Unwrapped positions are yielded as stored.
+
+    A configuration is only yielded once the next line has arrived, so that the final line of the stream is known. A
+    torn final line, i.e., a line without a terminating newline or with a wrong or missing checksum (see the check_line
+    function), is dropped. Such a line is left behind if the sampling program is killed while it writes a
+    configuration. Any other line that is not complete raises an error.
+
+    Parameters
+    ----------
+    file : BinaryIO
+        The output file or stream.
+    header : Dict[str, List[str]]
+        The dictionary that receives the values of each key in the header.
+
+    Yields
+    ------
+    List[float]
+        The next hard-disk configuration.
+
+    Raises
+    ------
+    RuntimeError
+        If a configuration line other than the final one is not complete, or if the first configuration is a delta
+        frame.
+    """
+    configuration = []
+    pending = None
+    for line in itertools.chain(file, [None]):
+        if line is not None and line.startswith(b"#"):
+            if line.endswith(b"\n"):
+                parse_header_line(line, header)
+            continue
+        if line is not None and not line.strip():
+            continue
+        if pending is not None:
+            if not check_line(pending, "checksums" in header):
+                if line is None:
+                    return
+                raise RuntimeError("The configuration line {0!r} is corrupt.".format(pending[:40]))
+            if pending.startswith(b"d") and not configuration:
+                raise RuntimeError("The first configuration is a delta frame.")
+            configuration = parse_configuration(pending, configuration, position_scale(header),
+                                                header.get("layout") == ["columnar"])
+            yield configuration
+        pending = line
+
+
+def read_configuration(filename: str, n: int) -> List[List[float]]:
+    """
+    Return the last hard-disk configuration in the given output file of a sampling program.
+
+    The file is read line by line with the stream_configurations function, so that it may contain delta frames, the
+    columnar layout, unwrapped positions (which are corrected for periodic boundary conditions), and checksums of the
+    ConfigurationWriter class. A torn final line is dropped. If the file is a manifest, the last shard with a
+    configuration is read. Quantized positions are rejected because restoring them to the midpoints of their
+    quantization levels can introduce overlaps in dense configurations.
+
+    Parameters
+    ----------
+    filename : str
+        The name of the output file.
+    n : int
+        The number of disks.
+
+    Returns
+    -------
+    List[List[float]]
+        The positions of all hard disks.
+
+    Raises
+    ------
+    RuntimeError
+        If the file contains no configuration, if a configuration line other than the final one is corrupt, or if the
+        configurations do not have n disks.
+    """
+    with open(filename, "rb") as file:
+        if file.readline().split() == [b"#", b"manifest"]:
+            directory = os.path.dirname(filename)
+            filenames = [os.path.join(directory, line.decode().strip()) for line in file if line.strip()][::-1]
+        else:
+            filenames = [filename]
+    for name in filenames:
+        header = {}
+        configuration = None
+        with open(name, "rb") as file:
+            for configuration in stream_configurations(file, header):
+                if "quantization" in header:
+                    raise RuntimeError("The output file {0} contains quantized positions, but --initial needs "
+                                       "full-precision output.".format(filename))
+        if configuration is not None:
+            break
+    else:
+        raise RuntimeError("The output file {0} contains no configuration.".format(filename))
+    if len(configuration) != 2 * n:
+        raise RuntimeError("The configurations in the output file {0} do not have {1} disks.".format(filename, n))
+    pos = [configuration[2 * k:2 * k + 2] for k in range(n)]
+    if "unwrapped" in header:
+        box = [float(b) for b in header["unwrapped"][:2]]
+        pos = [correct_periodic_position(s, box) for s in pos]
+    return pos
+
+
+def encode_varint(value: int) -> bytes:
+    """
+    Return the given non-negative integer as a variable-length integer (varint).
+
+    Every byte of a varint stores seven bits of the integer, starting with the least significant ones. The most
+    significant bit of a byte is set if further bytes follow. Integers smaller than 128 thus take a single byte.
+
+    Parameters
+    ----------
+    value : int
+        The non-negative integer.
+
+    Returns
+    -------
+    bytes
+        The varint.
+    """
+    data = bytearray()
+    while value >= 0x80:
+        data.append((value & 0x7f) | 0x80)
+        value >>= 7
+    data.append(value)
+    return bytes(data)
+
+
+def decode_varint(data: Union[bytes, mmap.mmap], offset: int) -> Tuple[int, int]:
+    """
+    Decode the variable-length integer (varint) that starts at the given offset of the given data.
+
+    Parameters
+    ----------
+    data : bytes or mmap.mmap
+        The data.
+    offset : int
+        The offset of the first byte of the varint.
+
+    Returns
+    -------
+    (int, int)
+        (The decoded integer, the offset of the first byte after the varint.)
+    """
+    value = 0
+    shift = 0
+    while True:
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7f) << shift
+        if byte < 0x80:
+            return value, offset
+        shift += 7
+
+
+class EventTraceWriter:
+    """
+    Writer of a compact binary trace of the events of an event-chain Monte Carlo run with straight chains.
+
+    The trace starts with the magic bytes b'HDTRACE1', the number of disks n as a varint (see the encode_varint
+    function), and the two components of the box as little-endian doubles. Then follows a sequence of records, each of
+    which starts with its type as a varint:
+
+    - Checkpoint (type 0): the number of events before the checkpoint as a varint and the 2 * n components of all disk
+      positions as little-endian doubles.
+    - Chain (type 1): the active disk and the direction of its velocity (0 for x and 1 for y) as varints.
+    - Event (type 2): the target disk as a varint and the event time as a little-endian double. The event that ends a
+      chain has the active disk as its target, and the remaining chain time as its event time.
+
+    The number of an event is implied by its position in the trace and is not stored. The event time is stored as it
+    was computed, i.e., including slightly negative values that result from rounding errors. A checkpoint is written
+    at the start of the first chain, and at the start of the first chain after every checkpoint_interval events. When
+    the writer is closed, a footer with the record type 3 is appended. It contains the number of checkpoints as a
+    varint, the number of events and the offset in the file of each checkpoint as varints, and finally the offset of
+    the footer as a little-endian 64-bit integer followed by the magic bytes. The footer allows readers to seek to the
+    nearest checkpoint. A trace without a footer (e.g., of a killed run) can still be read from its beginning.
+
+    Attributes
+    ----------
+    file : BinaryIO
+        The trace file.
+    checkpoint_interval : int
+        The minimum number of events between two checkpoints.
+    event_count : int
+        The number of events in the trace.
+    checkpoints : List[Tuple[int, int]]
+        The number of events before and the offset in the file of every checkpoint.
+    """
+    magic = b"HDTRACE1"
+    checkpoint_record = 0
+    chain_record = 1
+    event_record = 2
+    footer_record = 3
+
+    def __init__(self, filename: str, n: int, box: Sequence[float], checkpoint_interval: int = 100000):
+        """
+        Initialize the instance and write the header of the trace.
+
+        Parameters
+        ----------
+        filename : str
+            The name of the trace file.
+        n : int
+            The number of disks.
+        box : Sequence[float]
+            The geometry of the simulation box.
+        checkpoint_interval : int, optional
+            The minimum number of events between two checkpoints.
+        """
+        self.file = open(filename, "wb")
+        self.checkpoint_interval = checkpoint_interval
+        self.event_count = 0
+        self.checkpoints = []
+        self.file.write(self.magic + encode_varint(n) + struct.pack("<2d", *box))
+
+    def start_chain(self, pos: Sequence[Sequence[float]], active: int, direction: int) -> None:
+        """
+        Write the start of a chain, preceded by a checkpoint if one is due.
+
+        Parameters
+        ----------
+        pos : Sequence[Sequence[float]]
+            The positions of all hard disks at the start of the chain.
+        active : int
+            The active disk.
+        direction : int
+            The direction of the velocity of the active disk.
+        """
+        if not self.checkpoints or self.event_count - self.checkpoints[-1][0] >= self.checkpoint_interval:
+            self.checkpoints.append((self.event_count, self.file.tell()))
+            self.file.write(encode_varint(self.checkpoint_record) + encode_varint(self.event_count)
+                            + struct.pack("<{0}d".format(2 * len(pos)), *iter(comp for s in pos for comp in s)))
+        self.file.write(encode_varint(self.chain_record) + encode_varint(active) + encode_varint(direction))
+
+    def event(self, target: int, event_time: float) -> None:
+        """
+        Write an event.
+
+        Parameters
+        ----------
+        target : int
+            The target disk of the event.
+        event_time : float
+            The event time.
+        """
+        self.file.write(encode_varint(self.event_record) + encode_varint(target) + struct.pack("<d", event_time))
+        self.event_count += 1
+
+    def close(self) -> None:
+        """Write the footer and close the trace file."""
+        footer_offset = self.file.tell()
+        self.file.write(encode_varint(self.footer_record) + encode_varint(len(self.checkpoints)))
+        for event_count, offset in self.checkpoints:
+            self.file.write(encode_varint(event_count) + encode_varint(offset))
+        self.file.write(struct.pack("<q", footer_offset) + self.magic)
+        self.file.close()
+
+
+class EventTraceReader:
+    """
+    Reader of a binary event trace that was written by the EventTraceWriter class.
+
+    The reader replays the events of the trace, i.e., it moves the active disk by the stored event times and passes
+    the activity to the stored target disks. Unlike the sampling program, it therefore does not need to search for the
+    next event among all disks.
+
+    Attributes
+    ----------
+    data : mmap.mmap
+        The memory-mapped trace file.
+    n : int
+        The number of disks.
+    box : Tuple[float, float]
+        The geometry of the simulation box.
+    records_offset : int
+        The offset in the file of the first record.
+    checkpoints : List[Tuple[int, int]]
+        The number of events before and the offset in the file of every checkpoint, or only the first checkpoint if
+        the trace has no footer.
+    """
+    def __init__(self, filename: str):
+        """
+        Initialize the instance by mapping the given trace file into memory and by reading its header and footer.
+
+        Parameters
+        ----------
+        filename : str
+            The name of the trace file.
+
+        Raises
+        ------
+        RuntimeError
+            If the file is not an event trace.
+        """
+        with open(filename, "rb") as file:
+            self.data = mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ)
+        magic = EventTraceWriter.magic
+        if self.data[:len(magic)] != magic:
+            raise RuntimeError("The file {0} is not an event trace.".format(filename))
+        self.n, offset = decode_varint(self.data, len(magic))
+        self.box = struct.unpack_from("<2d", self.data, offset)
+        self.records_offset = offset + 16
+        self.checkpoints = [(0, self.records_offset)]
+        if len(self.data) >= self.records_offset + 16 and self.data[-len(magic):] == magic:
+            offset = struct.unpack_from("<q", self.data, len(self.data) - len(magic) - 8)[0]
+            record_type, offset = decode_varint(self.data, offset)
+            assert record_type == EventTraceWriter.footer_record
+            count, offset = decode_varint(self.data, offset)
+            self.checkpoints = []
+            for _ in range(count):
+                event_count, offset = decode_varint(self.data, offset)
+                checkpoint_offset, offset = decode_varint(self.data, offset)
+                self.checkpoints.append((event_count, checkpoint_offset))
+
+    def records(self, offset: int) -> Iterator[tuple]:
+        """
+        Yield the records of the trace starting at the given offset until the footer or the end of the file.
+
+        A record that was only partially written at the end of the file is not yielded.
+
+        Parameters
+        ----------
+        offset : int
+            The offset in the file of the first record.
+
+        Yields
+        ------
+        tuple
+            The record type followed by the content of the record (see the EventTraceWriter class).
+        """
+        end = len(self.data)
+        try:
+            while offset < end:
+                record_type, offset = decode_varint(self.data, offset)
+                if record_type == EventTraceWriter.event_record:
+                    target, offset = decode_varint(self.data, offset)
+                    event_time = struct.unpack_from("<d", self.data, offset)[0]
+                    offset += 8
+                    yield record_type, target, event_time
+                elif record_type == EventTraceWriter.chain_record:
+                    active, offset = decode_varint(self.data, offset)
+                    direction, offset = decode_varint(self.data, offset)
+                    yield record_type, active, direction
+                elif record_type == EventTraceWriter.checkpoint_record:
+                    event_count, offset = decode_varint(self.data, offset)
+                    components = struct.unpack_from("<{0}d".format(2 * self.n), self.data, offset)
+                    offset += 16 * self.n
+                    yield record_type, event_count, [list(components[2 * k:2 * k + 2]) for k in range(self.n)]
+                else:
+                    return
+        except (IndexError, struct.error):
+            return
+
+    def replay(self, event: int) -> List[List[float]]:
+        """
+        Return the configuration after the given number of events.
+
+        The replay starts at the last checkpoint before the given event.
+
+        Parameters
+        ----------
+        event : int
+            The number of events.
+
+        Returns
+        -------
+        List[List[float]]
+            The positions of all hard disks.
+
+        Raises
+        ------
+        RuntimeError
+            If the trace contains fewer events than the given number.
+        """
+        event_count, offset = max(c for c in self.checkpoints if c[0] <= event)
+        pos = None
+        active = direction = 0
+        for record in self.records(offset):
+            if record[0] == EventTraceWriter.event_record:
+                if event_count == event:
+                    break
+                pos[active][direction] += max(record[2], 0.0)
+                while pos[active][direction] > self.box[direction]:
+                    pos[active][direction] -= self.box[direction]
+                active = record[1]
+                event_count += 1
+            elif record[0] == EventTraceWriter.chain_record:
+                active, direction = record[1], record[2]
+            elif record[1] <= event:
+                event_count, pos = record[1], record[2]
+            else:
+                break
+        if pos is None or event_count != event:
+            raise RuntimeError("The event trace contains only {0} events.".format(event_count))
+        return pos
+
+    def negative_events(self) -> Iterator[Tuple[int, float]]:
+        """
+        Yield the number and the time of all events with a negative event time.
+
+        Yields
+        ------
+        (int, float)
+            (The number of the event, the event time.)
+        """
+        event_count = 0
+        for record in self.records(self.records_offset):
+            if record[0] == EventTraceWriter.event_record:
+                if record[2] < 0.0:
+                    yield event_count, record[2]
+                event_count += 1
+
+    def close(self) -> None:
+        """Unmap the trace file."""
+        self.data.close()
@@ -40,8 +40,9 @@ import argparse
 import math
 import random
 from typing import Sequence
-from common import correct_periodic_position, separation_vector, create_packed, create_crystal, sample_vel
-random.seed(1)
+from common import (separation_vector, create_initial_configuration, sample_vel, add_output_arguments,
+                    add_initial_arguments, add_replica_arguments, read_configuration, validate_configuration,
+                    start_replicas, ConfigurationWriter)
 
 parser = argparse.ArgumentParser()
 parser.add_argument("n_x", help="number of disks per row", type=int)
@@ -53,24 +54,24 @@ parser.add_argument("shape", choices=["square", "rectangle", "crystal"],
                     type=str)
 parser.add_argument("-t", "--sample_time", help="time between two samples (default=15.0)", default=15.0, type=float)
 parser.add_argument("-n", "--n_samples", help="number of samples (default=1000)", default=1000, type=int)
+parser.add_argument("-s", "--seed", help="seed of the random number generator (default=1)", default=1, type=int)
+add_initial_arguments(parser)
+add_replica_arguments(parser)
+add_output_arguments(parser, delta_frames=False)
 args = parser.parse_args()
+random.seed(args.seed)
 
 n = args.n_x * args.n_y
-sigma = math.sqrt(args.eta / (n * math.pi))
-
-if args.shape == "square":
-    aspect_ratio = 1.0
-    box = (1.0 / math.sqrt(aspect_ratio), math.sqrt(aspect_ratio))
-    pos = create_packed(n, sigma, box)
-elif args.shape == "rectangle":
-    aspect_ratio = math.sqrt(3.0) / 2.0
-    box = (1.0 / math.sqrt(aspect_ratio), math.sqrt(aspect_ratio))
-    pos = create_packed(n, sigma, box)
-else:
-    assert args.shape == "crystal"
-    aspect_ratio = math.sqrt(3.0) / 2.0 * args.n_y / args.n_x
-    box = (1.0 / math.sqrt(aspect_ratio), math.sqrt(aspect_ratio))
-    pos = create_crystal(args.n_x, args.n_y, sigma, box)
+sigma, box, pos = create_initial_configuration(args.n_x, args.n_y, args.eta, args.shape,
+                                               args.cache_dir if args.initial is None else None)
+
+if args.initial is not None:
+    pos = read_configuration(args.initial, n)
+    validate_configuration(pos, sigma, box)
+start_replicas(args)
+
+writer = ConfigurationWriter.from_arguments(args, box, n)
+images = [[0, 0] for _ in range(n)]
 
 vel = sample_vel(n)
 mean_vel = [0.0, 0.0]
@@ -129,8 +130,18 @@ sample_count = args.n_samples
 time_to_sample = args.sample_time
 vel_max = max(math.sqrt(v[0] ** 2 + v[1] ** 2) for v in vel)
 
+# The candidate events are stored in a single list that is allocated once. The kth entry is the collision time of the
+# disk pair pairs[k], the last two entries are the horizon and the sampling event. Events are referred to by their index
+# in this list so that the event loop does not create new event records.
+pairs = [(i, j) for i in range(n) for j in range(i + 1, n)]
+horizon_event = len(pairs)
+sample_event = len(pairs) + 1
+event_times = [0.0] * (len(pairs) + 2)
+event_indices = range(len(event_times))
+
 while sample_count > 0:
-    events = [(i, j, find_event(pos[i], vel[i], pos[j], vel[j], sigma, box)) for i in range(n) for j in range(i + 1, n)]
+    for k, (i, j) in enumerate(pairs):
+        event_times[k] = find_event(pos[i], vel[i], pos[j], vel[j], sigma, box)
     # As required by periodic boundary conditions, collisions with images of the disks are considered.
     # For each disk, only the collisions happening in a region centered at the disk are considered.
     # The region has the same geometry as the box, and it moves together with the disk.
@@ -138,28 +149,36 @@ while sample_count > 0:
     # The horizon is obtained by dividing the minimum possible distance between a disk and another disk out of its
     # region, by twice (an upper bound to) the maximum velocity of the disks. The factor two is due to the possible
     # head-on collision.
-    events.append((-1, -1, cutoff / vel_max / 2))
-    events.append((-2, -2, time_to_sample))
-    first_event = min(events, key=lambda m: m[2])
-    i, j, t = first_event
+    event_times[horizon_event] = cutoff / vel_max / 2
+    event_times[sample_event] = time_to_sample
+    first_event = min(event_indices, key=event_times.__getitem__)
+    t = event_times[first_event]
     time_to_sample -= t
-    for m in range(len(pos)):
-        pos[m] = correct_periodic_position([p + t * v for p, v in zip(pos[m], vel[m])], box)
-    if i != j:
+    for m in range(n):
+        for d in range(2):
+            position = pos[m][d] + t * vel[m][d]
+            pos[m][d] = position % box[d]
+            images[m][d] += round((position - pos[m][d]) / box[d])
+    if first_event < horizon_event:
+        i, j = pairs[first_event]
         delta_x = separation_vector(pos[j], pos[i], box)
         delta_v = [vj - vi for vj, vi in zip(vel[j], vel[i])]
         delta_x_norm = math.sqrt(delta_x[0] ** 2 + delta_x[1] ** 2)
         direction = [dx / delta_x_norm for dx in delta_x]
         delta_v_dot_direction = delta_v[0] * direction[0] + delta_v[1] * direction[1]
-        vel[i] = [vi + d * delta_v_dot_direction for vi, d in zip(vel[i], direction)]
-        vel[j] = [vj - d * delta_v_dot_direction for vj, d in zip(vel[j], direction)]
+        for d in range(2):
+            vel[i][d] += direction[d] * delta_v_dot_direction
+            vel[j][d] -= direction[d] * delta_v_dot_direction
         vel_max = max(vel_max, math.sqrt(vel[i][0] ** 2 + vel[i][1] ** 2),
                       math.sqrt(vel[j][0] ** 2 + vel[j][1] ** 2))
-    if i == -2:
+    if first_event == sample_event:
         time_to_sample = args.sample_time
         sample_count -= 1
-        # If vel_max is only updated in line 154, it is a monotonic increasing function of time.
+        # If vel_max is only updated in line 172, it is a monotonic increasing function of time.
         # We recalculate vel_max at a resampling to prevent it becoming too large.
         vel_max = max(vel, key=lambda v: math.sqrt(v[0] ** 2 + v[1] ** 2))
         vel_max = math.sqrt(vel_max[0] ** 2 + vel_max[1] ** 2)
-        print(*iter(comp for s in pos for comp in s))
+        if args.validate_interval > 0 and (args.n_samples - sample_count) % args.validate_interval == 0:
+            validate_configuration(pos, sigma, box)
+        writer.write(pos, images=images)
+writer.close()
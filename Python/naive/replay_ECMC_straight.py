@@ -0,0 +1,62 @@
+# HistoricDisks - Synopsis of pressure data, sampling algorithms and pressure estimators for the hard-disk model of
+# statistical physics
+# https://github.com/jellyfysh/HistoricDisks
+# Copyright (C) 2022 Botao Li, Yoshihiko Nishikawa, Philipp Höllmer, Louis Carillo, A. C. Maggs, and Werner Krauth
+#
+# This file is part of HistoricDisks.
+#
+# HistoricDisks is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+# License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# HistoricDisks is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+# warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along with HistoricDisks in the LICENSE file.
+# If not, see <https://www.gnu.org/licenses/>.
+#
+# If you use HistoricDisks in published work, please cite the following reference (see [Li2022] in References.bib):
+# Botao Li, Yoshihiko Nishikawa, Philipp Höllmer, Louis Carillo, A. C. Maggs, and Werner Krauth,
+# Hard-disk computer simulations---a historic perspective,
+# arXiv e-prints: 2207.07715 (2022), https://arxiv.org/abs/2207.07715.
+#
+"""
+Executable Python script that replays a binary event trace of the straight event-chain Monte Carlo algorithm, which is
+written by the script ECMC_straight.py with the --trace command-line argument.
+
+The script rebuilds the configuration after the given number of events from the nearest preceding checkpoint in the
+trace. Between the checkpoint and the requested event, the active disk is moved by the stored event times and passes
+the activity to the stored target disks. No collision search is necessary so that the replay of an event costs only a
+constant time, whereas the sampling program compares the active disk with all other disks. The replayed
+configuration is identical to the one of the original run.
+
+For more information about the command-line arguments, use the -h (or --help) command-line argument of this script.
+An exemplary run can be started via
+"python3 ECMC_straight.py 2 2 0.28 crystal --n_samples 10 --trace trace.bin" followed by
+"python3 replay_ECMC_straight.py trace.bin 1000".
+
+This script prints the replayed configuration to stdout in the same format as the sampling programs, i.e., the
+(2 * k)th and (2 * k + 1)th floats in the output are the x- and y-positions of the kth disk, respectively. If the
+--negative_times command-line argument is given, the script instead prints the number and the event time of every
+event with a negative event time.
+"""
+import argparse
+from common import add_output_arguments, ConfigurationWriter, EventTraceReader
+
+parser = argparse.ArgumentParser()
+parser.add_argument("trace", help="event trace written by ECMC_straight.py", type=str)
+parser.add_argument("event", help="number of events before the replayed configuration", nargs="?", default=0,
+                    type=int)
+parser.add_argument("--negative_times", help="print all events with a negative event time", action="store_true")
+add_output_arguments(parser, delta_frames=False, trajectory=False)
+args = parser.parse_args()
+
+reader = EventTraceReader(args.trace)
+if args.negative_times:
+    for event, event_time in reader.negative_events():
+        print(event, event_time)
+else:
+    writer = ConfigurationWriter.from_arguments(args, reader.box, reader.n)
+    writer.write(reader.replay(args.event))
+    writer.close()
+reader.close()